@@ -0,0 +1,303 @@
+#pragma once
+
+#include "SimpleGLSL.h"
+
+namespace glsl {
+
+#ifndef INSTANCE_BUFFER_SEGMENTS
+#define INSTANCE_BUFFER_SEGMENTS 3
+#endif
+
+/**
+ * Streams per-instance vertex attributes (e.g. a model matrix and a color) instead of setting
+ * uniforms and issuing a draw call per object.
+ *
+ * The buffer is split into @c INSTANCE_BUFFER_SEGMENTS segments that are used round robin. If the
+ * buffer mapping functions were given to the @c Context, the segments are persistently mapped
+ * (or mapped unsynchronized per draw) and a fence guards the reuse of a segment that the gpu
+ * might still read from. Without them the buffer is orphaned before every upload.
+ *
+ * @code
+ * InstanceBuffer instances(ctx, 1024);
+ * instances.addAttribute(shader, "a_model", 4, 4);
+ * instances.addAttribute(shader, "a_color", 4);
+ * instances.init();
+ * for (const Object& o : objects) {
+ *   float* data = instances.add();
+ *   memcpy(data, glm::value_ptr(o.model), 16 * sizeof(float));
+ *   memcpy(data + 16, glm::value_ptr(o.color), 4 * sizeof(float));
+ * }
+ * instances.drawArrays(shader, GL_TRIANGLES, 0, vertexCount);
+ * @endcode
+ */
+class InstanceBuffer {
+protected:
+	struct Attribute {
+		int location;
+		// amount of floats per location
+		int components;
+		// amount of consecutive locations - 4 for a mat4
+		int locations;
+		std::size_t offset;
+	};
+
+	Context* _ctx;
+	std::vector<Attribute> _attributes;
+	// size of a single instance in bytes
+	std::size_t _stride;
+	uint32_t _maxInstances;
+	uint32_t _count;
+
+	GLuint _buffer;
+	int _segment;
+	// the current segment of the persistently mapped buffer or _staging
+	uint8_t* _data;
+	uint8_t* _mapped;
+	std::vector<uint8_t> _staging;
+	bool _persistent;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+	GLsync _fences[INSTANCE_BUFFER_SEGMENTS];
+
+	bool canMap() const {
+		return _ctx->ctx_glMapBufferRange != nullptr && _ctx->ctx_glFenceSync != nullptr;
+	}
+
+	// blocks until the gpu finished reading from the current segment
+	void waitForSegment() {
+		GLsync& fence = _fences[_segment];
+		if (fence == nullptr)
+			return;
+		for (;;) {
+			const GLenum status = _ctx->ctx_glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			if (status != GL_TIMEOUT_EXPIRED)
+				break;
+		}
+		_ctx->ctx_glDeleteSync(fence);
+		fence = nullptr;
+	}
+#else
+	bool canMap() const {
+		return false;
+	}
+
+	void waitForSegment() {
+	}
+#endif
+
+	std::size_t segmentSize() const {
+		return _stride * _maxInstances;
+	}
+
+	// the offset of the current segment in the buffer
+	std::size_t segmentOffset() const {
+		return canMap() ? segmentSize() * _segment : 0;
+	}
+
+	void beginSegment() {
+		waitForSegment();
+		if (_persistent) {
+			_data = _mapped + segmentOffset();
+		}
+	}
+
+	// hands the instances over to the gl - one upload for all instances of the draw call
+	void upload() {
+		const std::size_t size = _stride * _count;
+		_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+		if (_persistent)
+			return;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		if (canMap()) {
+			const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+			void* dest = _ctx->ctx_glMapBufferRange(GL_ARRAY_BUFFER, segmentOffset(), size, access);
+			if (dest != nullptr) {
+				::memcpy(dest, _data, size);
+				_ctx->ctx_glUnmapBuffer(GL_ARRAY_BUFFER);
+				return;
+			}
+			// the mapping failed - keep the segment layout, the fence already guarantees that the gpu is done with it
+			_ctx->ctx_glBufferSubData(GL_ARRAY_BUFFER, segmentOffset(), size, _data);
+			return;
+		}
+#endif
+		// orphan the old storage - the driver hands out a fresh one while the gpu still reads from the old
+		_ctx->ctx_glBufferData(GL_ARRAY_BUFFER, segmentSize(), nullptr, GL_STREAM_DRAW);
+		_ctx->ctx_glBufferSubData(GL_ARRAY_BUFFER, 0, size, _data);
+	}
+
+	void bindAttributes(const Shader& shader) {
+		const std::size_t base = segmentOffset();
+		for (const Attribute& a : _attributes) {
+			for (int i = 0; i < a.locations; ++i) {
+				const int location = a.location + i;
+				const std::size_t offset = base + a.offset + i * a.components * sizeof(float);
+				shader.enableVertexAttribute(location);
+				shader.setVertexAttribute(location, a.components, GL_FLOAT, false, static_cast<int>(_stride), reinterpret_cast<void*>(offset));
+				shader.setVertexAttributeDivisor(location, 1);
+			}
+		}
+	}
+
+	void unbindAttributes(const Shader& shader) {
+		for (const Attribute& a : _attributes) {
+			for (int i = 0; i < a.locations; ++i) {
+				shader.setVertexAttributeDivisor(a.location + i, 0);
+				shader.disableVertexAttribute(a.location + i);
+			}
+		}
+		_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void endSegment() {
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		if (canMap()) {
+			_fences[_segment] = _ctx->ctx_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			_segment = (_segment + 1) % INSTANCE_BUFFER_SEGMENTS;
+		}
+#endif
+		_count = 0;
+		beginSegment();
+	}
+
+public:
+	InstanceBuffer(Context* ctx, uint32_t maxInstances) :
+			_ctx(ctx), _stride(0), _maxInstances(maxInstances), _count(0), _buffer(0), _segment(0), _data(nullptr), _mapped(nullptr), _persistent(false) {
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		for (int i = 0; i < INSTANCE_BUFFER_SEGMENTS; ++i) {
+			_fences[i] = nullptr;
+		}
+#endif
+	}
+
+	virtual ~InstanceBuffer() {
+		shutdown();
+	}
+
+	/**
+	 * @brief Declares a per-instance attribute of the given shader - call this before @c init()
+	 *
+	 * @param[in] components The amount of floats per location
+	 * @param[in] locations The amount of consecutive locations - e.g. 4 for a @c mat4
+	 * @return The offset in floats of the attribute inside of an instance or @c -1 if the shader doesn't use the attribute
+	 */
+	int addAttribute(const Shader& shader, const std::string& name, int components, int locations = 1) {
+		const int location = shader.getAttributeLocation(name);
+		if (location == -1)
+			return -1;
+		const std::size_t offset = _stride;
+		_attributes.push_back(Attribute{location, components, locations, offset});
+		_stride += components * locations * sizeof(float);
+		return static_cast<int>(offset / sizeof(float));
+	}
+
+	bool init() {
+		if (_stride == 0) {
+			std::cerr << "no instance attributes were added" << std::endl;
+			return false;
+		}
+		_ctx->ctx_glGenBuffers(1, &_buffer);
+		_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+		const std::size_t size = canMap() ? segmentSize() * INSTANCE_BUFFER_SEGMENTS : segmentSize();
+#if defined(GL_SYNC_GPU_COMMANDS_COMPLETE) && defined(GL_MAP_PERSISTENT_BIT)
+		if (canMap() && _ctx->ctx_glBufferStorage != nullptr) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			_ctx->ctx_glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+			void* mapped = _ctx->ctx_glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+			if (mapped != nullptr) {
+				_persistent = true;
+				_mapped = static_cast<uint8_t*>(mapped);
+				_data = _mapped;
+			} else {
+				// the storage is immutable now - glBufferData would fail, so start over with a fresh buffer
+				_ctx->ctx_glDeleteBuffers(1, &_buffer);
+				_ctx->ctx_glGenBuffers(1, &_buffer);
+				_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+			}
+		}
+#endif
+		if (!_persistent) {
+			_ctx->ctx_glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			_staging.resize(segmentSize());
+			_data = _staging.data();
+		}
+		_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return true;
+	}
+
+	void shutdown() {
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		for (int i = 0; i < INSTANCE_BUFFER_SEGMENTS; ++i) {
+			if (_fences[i] != nullptr) {
+				_ctx->ctx_glDeleteSync(_fences[i]);
+				_fences[i] = nullptr;
+			}
+		}
+		if (_persistent) {
+			_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+			_ctx->ctx_glUnmapBuffer(GL_ARRAY_BUFFER);
+			_ctx->ctx_glBindBuffer(GL_ARRAY_BUFFER, 0);
+			_persistent = false;
+			_mapped = nullptr;
+		}
+#endif
+		if (_buffer != 0) {
+			_ctx->ctx_glDeleteBuffers(1, &_buffer);
+			_buffer = 0;
+		}
+		_data = nullptr;
+	}
+
+	/**
+	 * @brief Returns the memory for the next instance - write @c getStride() bytes into it
+	 *
+	 * @return @c nullptr if the buffer is full - draw the collected instances first
+	 */
+	float* add() {
+		if (_count >= _maxInstances)
+			return nullptr;
+		uint8_t* instance = _data + _stride * _count;
+		++_count;
+		return reinterpret_cast<float*>(instance);
+	}
+
+	std::size_t getStride() const {
+		return _stride;
+	}
+
+	uint32_t getCount() const {
+		return _count;
+	}
+
+	bool isFull() const {
+		return _count >= _maxInstances;
+	}
+
+	/**
+	 * @brief Draws the collected instances with a single call and starts to collect new ones
+	 *
+	 * The per-vertex attributes of the mesh must already be set up.
+	 */
+	void drawArrays(const Shader& shader, GLenum mode, GLint first, GLsizei vertices) {
+		if (_count == 0)
+			return;
+		upload();
+		bindAttributes(shader);
+		_ctx->ctx_glDrawArraysInstanced(mode, first, vertices, _count);
+		unbindAttributes(shader);
+		endSegment();
+	}
+
+	void drawElements(const Shader& shader, GLenum mode, GLsizei indices, GLenum type, const GLvoid* offset) {
+		if (_count == 0)
+			return;
+		upload();
+		bindAttributes(shader);
+		_ctx->ctx_glDrawElementsInstanced(mode, indices, type, offset, _count);
+		unbindAttributes(shader);
+		endSegment();
+	}
+};
+
+#undef INSTANCE_BUFFER_SEGMENTS
+
+}
@@ -0,0 +1,841 @@
+#pragma once
+
+#include "SimpleGLSL.h"
+#include "ShaderTraceFormat.h"
+
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace glsl {
+
+/**
+ * Raw bytes that are stored inline in a trace record
+ */
+struct TraceBlob {
+	const void* data;
+	uint32_t size;
+};
+
+/**
+ * Replaces the gl function table of a @c Context with wrappers that append a binary record for every
+ * call to a preallocated ring buffer. A background thread writes the records to disk, so the render
+ * thread never touches the file. Records are dropped (and counted) if the writer can't keep up.
+ *
+ * There can only be one active recorder at a time - just like there should only be one @c Context.
+ * Call @c endFrame() once per frame to allow the analyzer to split the trace into frames.
+ *
+ * @see TraceReader
+ */
+class TraceRecorder {
+protected:
+	// the original function table of the context
+	struct Functions {
+		decltype(Context::ctx_glCreateShader) glCreateShader;
+		decltype(Context::ctx_glDeleteShader) glDeleteShader;
+		decltype(Context::ctx_glShaderSource) glShaderSource;
+		decltype(Context::ctx_glCompileShader) glCompileShader;
+		decltype(Context::ctx_glGetShaderiv) glGetShaderiv;
+		decltype(Context::ctx_glGetShaderInfoLog) glGetShaderInfoLog;
+		decltype(Context::ctx_glCreateProgram) glCreateProgram;
+		decltype(Context::ctx_glDeleteProgram) glDeleteProgram;
+		decltype(Context::ctx_glAttachShader) glAttachShader;
+		decltype(Context::ctx_glDetachShader) glDetachShader;
+		decltype(Context::ctx_glLinkProgram) glLinkProgram;
+		decltype(Context::ctx_glUseProgram) glUseProgram;
+		decltype(Context::ctx_glGetProgramiv) glGetProgramiv;
+		decltype(Context::ctx_glGetActiveUniform) glGetActiveUniform;
+		decltype(Context::ctx_glGetProgramInfoLog) glGetProgramInfoLog;
+		decltype(Context::ctx_glGetUniformLocation) glGetUniformLocation;
+		decltype(Context::ctx_glUniform1i) glUniform1i;
+		decltype(Context::ctx_glUniform2i) glUniform2i;
+		decltype(Context::ctx_glUniform3i) glUniform3i;
+		decltype(Context::ctx_glUniform4i) glUniform4i;
+		decltype(Context::ctx_glUniform1f) glUniform1f;
+		decltype(Context::ctx_glUniform2f) glUniform2f;
+		decltype(Context::ctx_glUniform3f) glUniform3f;
+		decltype(Context::ctx_glUniform4f) glUniform4f;
+		decltype(Context::ctx_glUniform1fv) glUniform1fv;
+		decltype(Context::ctx_glUniform2fv) glUniform2fv;
+		decltype(Context::ctx_glUniform3fv) glUniform3fv;
+		decltype(Context::ctx_glUniform4fv) glUniform4fv;
+		decltype(Context::ctx_glGetActiveAttrib) glGetActiveAttrib;
+		decltype(Context::ctx_glGetAttribLocation) glGetAttribLocation;
+		decltype(Context::ctx_glUniformMatrix2fv) glUniformMatrix2fv;
+		decltype(Context::ctx_glUniformMatrix3fv) glUniformMatrix3fv;
+		decltype(Context::ctx_glUniformMatrix4fv) glUniformMatrix4fv;
+		decltype(Context::ctx_glVertexAttrib4f) glVertexAttrib4f;
+		decltype(Context::ctx_glVertexAttribPointer) glVertexAttribPointer;
+		decltype(Context::ctx_glEnableVertexAttribArray) glEnableVertexAttribArray;
+		decltype(Context::ctx_glDisableVertexAttribArray) glDisableVertexAttribArray;
+		decltype(Context::ctx_glBindAttribLocation) glBindAttribLocation;
+		decltype(Context::ctx_glVertexAttribDivisor) glVertexAttribDivisor;
+		decltype(Context::ctx_glGenBuffers) glGenBuffers;
+		decltype(Context::ctx_glDeleteBuffers) glDeleteBuffers;
+		decltype(Context::ctx_glBindBuffer) glBindBuffer;
+		decltype(Context::ctx_glBufferData) glBufferData;
+		decltype(Context::ctx_glBufferSubData) glBufferSubData;
+		decltype(Context::ctx_glDrawArraysInstanced) glDrawArraysInstanced;
+		decltype(Context::ctx_glDrawElementsInstanced) glDrawElementsInstanced;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		decltype(Context::ctx_glMapBufferRange) glMapBufferRange;
+		decltype(Context::ctx_glUnmapBuffer) glUnmapBuffer;
+		decltype(Context::ctx_glBufferStorage) glBufferStorage;
+		decltype(Context::ctx_glFenceSync) glFenceSync;
+		decltype(Context::ctx_glClientWaitSync) glClientWaitSync;
+		decltype(Context::ctx_glDeleteSync) glDeleteSync;
+#endif
+	};
+
+	Context* _ctx;
+	Functions _gl;
+	std::FILE* _file;
+	std::chrono::steady_clock::time_point _start;
+
+	// single producer (the render thread), single consumer (the writer thread)
+	std::vector<uint8_t> _ring;
+	std::size_t _mask;
+	std::atomic<std::size_t> _head;
+	std::atomic<std::size_t> _tail;
+	std::size_t _cursor;
+	uint32_t _dropped;
+
+	std::thread _writer;
+	std::mutex _mutex;
+	std::condition_variable _wakeup;
+	std::atomic<bool> _stop;
+
+	static TraceRecorder*& current() {
+		static TraceRecorder* recorder = nullptr;
+		return recorder;
+	}
+
+	static std::size_t varIntSize(uint32_t value) {
+		std::size_t size = 1;
+		while (value >= 0x80) {
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+
+	static std::size_t payloadSize() {
+		return 0;
+	}
+
+	template<typename T, typename ... Args>
+	static std::size_t payloadSize(const T&, const Args&... args) {
+		return sizeof(T) + payloadSize(args...);
+	}
+
+	template<typename ... Args>
+	static std::size_t payloadSize(const TraceBlob& blob, const Args&... args) {
+		return sizeof(blob.size) + blob.size + payloadSize(args...);
+	}
+
+	void putBytes(const void* data, std::size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			_ring[(_cursor + i) & _mask] = bytes[i];
+		}
+		_cursor += size;
+	}
+
+	void put() {
+	}
+
+	template<typename T, typename ... Args>
+	void put(const T& value, const Args&... args) {
+		putBytes(&value, sizeof(T));
+		put(args...);
+	}
+
+	template<typename ... Args>
+	void put(const TraceBlob& blob, const Args&... args) {
+		putBytes(&blob.size, sizeof(blob.size));
+		putBytes(blob.data, blob.size);
+		put(args...);
+	}
+
+	// ring buffer space that only the control records (frame end and dropped counter) may use
+	static const std::size_t CONTROL_RESERVE = 32;
+
+	static bool isControlRecord(TraceCall call) {
+		return call == TRACE_FrameEnd || call == TRACE_Dropped;
+	}
+
+	/**
+	 * @brief Reserves the space for a record and writes its header
+	 *
+	 * Control records may use the reserved headroom and wait for the writer thread if even that
+	 * is used up - they are never dropped.
+	 *
+	 * @return @c false if the ring buffer is full
+	 */
+	bool begin(TraceCall call, std::size_t size) {
+		const std::size_t head = _head.load(std::memory_order_relaxed);
+		const std::size_t recordSize = 1 + sizeof(uint32_t) + varIntSize(static_cast<uint32_t>(size)) + size;
+		const bool control = isControlRecord(call);
+		const std::size_t reserve = control ? 0 : CONTROL_RESERVE;
+		for (;;) {
+			const std::size_t used = head - _tail.load(std::memory_order_acquire);
+			if (recordSize + reserve <= _ring.size() - used)
+				break;
+			if (!control) {
+				++_dropped;
+				return false;
+			}
+			_wakeup.notify_one();
+			std::this_thread::yield();
+		}
+		_cursor = head;
+		const uint8_t id = static_cast<uint8_t>(call);
+		const auto elapsed = std::chrono::steady_clock::now() - _start;
+		const uint32_t micros = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+		putBytes(&id, sizeof(id));
+		putBytes(&micros, sizeof(micros));
+		uint32_t value = static_cast<uint32_t>(size);
+		while (value >= 0x80) {
+			const uint8_t byte = static_cast<uint8_t>((value & 0x7F) | 0x80);
+			putBytes(&byte, 1);
+			value >>= 7;
+		}
+		const uint8_t byte = static_cast<uint8_t>(value);
+		putBytes(&byte, 1);
+		return true;
+	}
+
+	void commit() {
+		_head.store(_cursor, std::memory_order_release);
+		if (_cursor - _tail.load(std::memory_order_relaxed) > _ring.size() / 2) {
+			_wakeup.notify_one();
+		}
+	}
+
+	template<typename ... Args>
+	bool record(TraceCall call, const Args&... args) {
+		if (!begin(call, payloadSize(args...)))
+			return false;
+		put(args...);
+		commit();
+		return true;
+	}
+
+	// writes everything between tail and head to the file - only called by the writer thread
+	void drain() {
+		const std::size_t head = _head.load(std::memory_order_acquire);
+		std::size_t tail = _tail.load(std::memory_order_relaxed);
+		while (tail != head) {
+			const std::size_t index = tail & _mask;
+			const std::size_t chunk = std::min(head - tail, _ring.size() - index);
+			std::fwrite(&_ring[index], 1, chunk, _file);
+			tail += chunk;
+		}
+		_tail.store(tail, std::memory_order_release);
+	}
+
+	void writerLoop() {
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wakeup.wait_for(lock, std::chrono::milliseconds(10));
+			}
+			drain();
+			if (_stop.load())
+				break;
+		}
+		drain();
+		std::fflush(_file);
+	}
+
+	static GLuint traceCreateShader(GLenum type) {
+		TraceRecorder* t = current();
+		const GLuint id = t->_gl.glCreateShader(type);
+		t->record(TRACE_CreateShader, type, id);
+		return id;
+	}
+
+	static void traceDeleteShader(GLuint id) {
+		TraceRecorder* t = current();
+		t->_gl.glDeleteShader(id);
+		t->record(TRACE_DeleteShader, id);
+	}
+
+	static void traceShaderSource(GLuint id, GLuint count, const GLchar **sources, GLuint *len) {
+		TraceRecorder* t = current();
+		t->_gl.glShaderSource(id, count, sources, len);
+		std::size_t size = payloadSize(id, count);
+		for (GLuint i = 0; i < count; ++i) {
+			size += sizeof(uint32_t) + (len != nullptr ? len[i] : ::strlen(sources[i]));
+		}
+		if (!t->begin(TRACE_ShaderSource, size))
+			return;
+		t->put(id, count);
+		for (GLuint i = 0; i < count; ++i) {
+			const uint32_t length = static_cast<uint32_t>(len != nullptr ? len[i] : ::strlen(sources[i]));
+			t->put(TraceBlob{sources[i], length});
+		}
+		t->commit();
+	}
+
+	static void traceCompileShader(GLuint id) {
+		TraceRecorder* t = current();
+		t->_gl.glCompileShader(id);
+		t->record(TRACE_CompileShader, id);
+	}
+
+	static void traceGetShaderiv(GLuint id, GLenum field, GLint *dest) {
+		TraceRecorder* t = current();
+		t->_gl.glGetShaderiv(id, field, dest);
+		t->record(TRACE_GetShaderiv, id, field, *dest);
+	}
+
+	static void traceGetShaderInfoLog(GLuint id, GLuint maxlen, GLuint *len, GLchar *dest) {
+		TraceRecorder* t = current();
+		t->_gl.glGetShaderInfoLog(id, maxlen, len, dest);
+		t->record(TRACE_GetShaderInfoLog, id, maxlen);
+	}
+
+	static GLuint traceCreateProgram(void) {
+		TraceRecorder* t = current();
+		const GLuint id = t->_gl.glCreateProgram();
+		t->record(TRACE_CreateProgram, id);
+		return id;
+	}
+
+	static void traceDeleteProgram(GLuint id) {
+		TraceRecorder* t = current();
+		t->_gl.glDeleteProgram(id);
+		t->record(TRACE_DeleteProgram, id);
+	}
+
+	static void traceAttachShader(GLuint prog, GLuint shader) {
+		TraceRecorder* t = current();
+		t->_gl.glAttachShader(prog, shader);
+		t->record(TRACE_AttachShader, prog, shader);
+	}
+
+	static void traceDetachShader(GLuint prog, GLuint shader) {
+		TraceRecorder* t = current();
+		t->_gl.glDetachShader(prog, shader);
+		t->record(TRACE_DetachShader, prog, shader);
+	}
+
+	static void traceLinkProgram(GLuint id) {
+		TraceRecorder* t = current();
+		t->_gl.glLinkProgram(id);
+		t->record(TRACE_LinkProgram, id);
+	}
+
+	static void traceUseProgram(GLuint id) {
+		TraceRecorder* t = current();
+		t->_gl.glUseProgram(id);
+		t->record(TRACE_UseProgram, id);
+	}
+
+	static void traceGetProgramiv(GLuint id, GLenum field, GLint *dest) {
+		TraceRecorder* t = current();
+		t->_gl.glGetProgramiv(id, field, dest);
+		t->record(TRACE_GetProgramiv, id, field, *dest);
+	}
+
+	static void traceGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name) {
+		TraceRecorder* t = current();
+		t->_gl.glGetActiveUniform(program, index, bufSize, length, size, type, name);
+		t->record(TRACE_GetActiveUniform, program, index, TraceBlob{name, static_cast<uint32_t>(::strlen(name))});
+	}
+
+	static void traceGetProgramInfoLog(GLuint id, GLuint maxlen, GLuint *len, GLchar *dest) {
+		TraceRecorder* t = current();
+		t->_gl.glGetProgramInfoLog(id, maxlen, len, dest);
+		t->record(TRACE_GetProgramInfoLog, id, maxlen);
+	}
+
+	static GLint traceGetUniformLocation(GLuint id, const GLchar *name) {
+		TraceRecorder* t = current();
+		const GLint location = t->_gl.glGetUniformLocation(id, name);
+		t->record(TRACE_GetUniformLocation, id, location, TraceBlob{name, static_cast<uint32_t>(::strlen(name))});
+		return location;
+	}
+
+	static void traceUniform1i(GLint location, GLint i) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform1i(location, i);
+		t->record(TRACE_Uniform1i, location, i);
+	}
+
+	static void traceUniform2i(GLint location, GLint i1, GLint i2) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform2i(location, i1, i2);
+		t->record(TRACE_Uniform2i, location, i1, i2);
+	}
+
+	static void traceUniform3i(GLint location, GLint i1, GLint i2, GLint i3) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform3i(location, i1, i2, i3);
+		t->record(TRACE_Uniform3i, location, i1, i2, i3);
+	}
+
+	static void traceUniform4i(GLint location, GLint i1, GLint i2, GLint i3, GLint i4) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform4i(location, i1, i2, i3, i4);
+		t->record(TRACE_Uniform4i, location, i1, i2, i3, i4);
+	}
+
+	static void traceUniform1f(GLint location, GLfloat f) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform1f(location, f);
+		t->record(TRACE_Uniform1f, location, f);
+	}
+
+	static void traceUniform2f(GLint location, GLfloat f1, GLfloat f2) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform2f(location, f1, f2);
+		t->record(TRACE_Uniform2f, location, f1, f2);
+	}
+
+	static void traceUniform3f(GLint location, GLfloat f1, GLfloat f2, GLfloat f3) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform3f(location, f1, f2, f3);
+		t->record(TRACE_Uniform3f, location, f1, f2, f3);
+	}
+
+	static void traceUniform4f(GLint location, GLfloat f1, GLfloat f2, GLfloat f3, GLfloat f4) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform4f(location, f1, f2, f3, f4);
+		t->record(TRACE_Uniform4f, location, f1, f2, f3, f4);
+	}
+
+	static void traceUniform1fv(GLint location, int count, GLfloat *f) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform1fv(location, count, f);
+		t->record(TRACE_Uniform1fv, location, TraceBlob{f, static_cast<uint32_t>(count * sizeof(GLfloat))});
+	}
+
+	static void traceUniform2fv(GLint location, int count, GLfloat *f) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform2fv(location, count, f);
+		t->record(TRACE_Uniform2fv, location, TraceBlob{f, static_cast<uint32_t>(count * 2 * sizeof(GLfloat))});
+	}
+
+	static void traceUniform3fv(GLint location, int count, GLfloat *f) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform3fv(location, count, f);
+		t->record(TRACE_Uniform3fv, location, TraceBlob{f, static_cast<uint32_t>(count * 3 * sizeof(GLfloat))});
+	}
+
+	static void traceUniform4fv(GLint location, int count, GLfloat *f) {
+		TraceRecorder* t = current();
+		t->_gl.glUniform4fv(location, count, f);
+		t->record(TRACE_Uniform4fv, location, TraceBlob{f, static_cast<uint32_t>(count * 4 * sizeof(GLfloat))});
+	}
+
+	static void traceGetActiveAttrib(GLuint program, GLuint index, GLsizei bufsize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+		TraceRecorder* t = current();
+		t->_gl.glGetActiveAttrib(program, index, bufsize, length, size, type, name);
+		t->record(TRACE_GetActiveAttrib, program, index, TraceBlob{name, static_cast<uint32_t>(::strlen(name))});
+	}
+
+	static GLint traceGetAttribLocation(GLuint id, const GLchar *name) {
+		TraceRecorder* t = current();
+		const GLint location = t->_gl.glGetAttribLocation(id, name);
+		t->record(TRACE_GetAttribLocation, id, location, TraceBlob{name, static_cast<uint32_t>(::strlen(name))});
+		return location;
+	}
+
+	static void traceUniformMatrix2fv(GLint location, int count, GLboolean transpose, GLfloat *v) {
+		TraceRecorder* t = current();
+		t->_gl.glUniformMatrix2fv(location, count, transpose, v);
+		t->record(TRACE_UniformMatrix2fv, location, transpose, TraceBlob{v, static_cast<uint32_t>(count * 4 * sizeof(GLfloat))});
+	}
+
+	static void traceUniformMatrix3fv(GLint location, int count, GLboolean transpose, GLfloat *v) {
+		TraceRecorder* t = current();
+		t->_gl.glUniformMatrix3fv(location, count, transpose, v);
+		t->record(TRACE_UniformMatrix3fv, location, transpose, TraceBlob{v, static_cast<uint32_t>(count * 9 * sizeof(GLfloat))});
+	}
+
+	static void traceUniformMatrix4fv(GLint location, int count, GLboolean transpose, GLfloat *v) {
+		TraceRecorder* t = current();
+		t->_gl.glUniformMatrix4fv(location, count, transpose, v);
+		t->record(TRACE_UniformMatrix4fv, location, transpose, TraceBlob{v, static_cast<uint32_t>(count * 16 * sizeof(GLfloat))});
+	}
+
+	static void traceVertexAttrib4f(GLuint indx, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+		TraceRecorder* t = current();
+		t->_gl.glVertexAttrib4f(indx, x, y, z, w);
+		t->record(TRACE_VertexAttrib4f, indx, x, y, z, w);
+	}
+
+	static uint64_t traceHandle(const void* ptr) {
+		return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+	}
+
+	static void traceVertexAttribPointer(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* ptr) {
+		TraceRecorder* t = current();
+		t->_gl.glVertexAttribPointer(indx, size, type, normalized, stride, ptr);
+		t->record(TRACE_VertexAttribPointer, indx, size, type, normalized, stride, traceHandle(ptr));
+	}
+
+	static void traceEnableVertexAttribArray(GLuint indx) {
+		TraceRecorder* t = current();
+		t->_gl.glEnableVertexAttribArray(indx);
+		t->record(TRACE_EnableVertexAttribArray, indx);
+	}
+
+	static void traceDisableVertexAttribArray(GLuint indx) {
+		TraceRecorder* t = current();
+		t->_gl.glDisableVertexAttribArray(indx);
+		t->record(TRACE_DisableVertexAttribArray, indx);
+	}
+
+	static void traceBindAttribLocation(GLuint program, GLuint index, const GLchar *name) {
+		TraceRecorder* t = current();
+		t->_gl.glBindAttribLocation(program, index, name);
+		t->record(TRACE_BindAttribLocation, program, index, TraceBlob{name, static_cast<uint32_t>(::strlen(name))});
+	}
+
+	static void traceVertexAttribDivisor(GLuint indx, GLuint divisor) {
+		TraceRecorder* t = current();
+		t->_gl.glVertexAttribDivisor(indx, divisor);
+		t->record(TRACE_VertexAttribDivisor, indx, divisor);
+	}
+
+	static void traceGenBuffers(GLsizei n, GLuint *buffers) {
+		TraceRecorder* t = current();
+		t->_gl.glGenBuffers(n, buffers);
+		t->record(TRACE_GenBuffers, TraceBlob{buffers, static_cast<uint32_t>(n * sizeof(GLuint))});
+	}
+
+	static void traceDeleteBuffers(GLsizei n, const GLuint *buffers) {
+		TraceRecorder* t = current();
+		t->_gl.glDeleteBuffers(n, buffers);
+		t->record(TRACE_DeleteBuffers, TraceBlob{buffers, static_cast<uint32_t>(n * sizeof(GLuint))});
+	}
+
+	static void traceBindBuffer(GLenum target, GLuint buffer) {
+		TraceRecorder* t = current();
+		t->_gl.glBindBuffer(target, buffer);
+		t->record(TRACE_BindBuffer, target, buffer);
+	}
+
+	static void traceBufferData(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage) {
+		TraceRecorder* t = current();
+		t->_gl.glBufferData(target, size, data, usage);
+		t->record(TRACE_BufferData, target, static_cast<int64_t>(size), usage);
+	}
+
+	static void traceBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data) {
+		TraceRecorder* t = current();
+		t->_gl.glBufferSubData(target, offset, size, data);
+		t->record(TRACE_BufferSubData, target, static_cast<int64_t>(offset), static_cast<int64_t>(size));
+	}
+
+	static void traceDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+		TraceRecorder* t = current();
+		t->_gl.glDrawArraysInstanced(mode, first, count, instances);
+		t->record(TRACE_DrawArraysInstanced, mode, first, count, instances);
+	}
+
+	static void traceDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instances) {
+		TraceRecorder* t = current();
+		t->_gl.glDrawElementsInstanced(mode, count, type, indices, instances);
+		t->record(TRACE_DrawElementsInstanced, mode, count, type, traceHandle(indices), instances);
+	}
+
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+	static void* traceMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+		TraceRecorder* t = current();
+		void* mapped = t->_gl.glMapBufferRange(target, offset, length, access);
+		t->record(TRACE_MapBufferRange, target, static_cast<int64_t>(offset), static_cast<int64_t>(length), access, traceHandle(mapped));
+		return mapped;
+	}
+
+	static GLboolean traceUnmapBuffer(GLenum target) {
+		TraceRecorder* t = current();
+		const GLboolean result = t->_gl.glUnmapBuffer(target);
+		t->record(TRACE_UnmapBuffer, target, result);
+		return result;
+	}
+
+	static void traceBufferStorage(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags) {
+		TraceRecorder* t = current();
+		t->_gl.glBufferStorage(target, size, data, flags);
+		t->record(TRACE_BufferStorage, target, static_cast<int64_t>(size), flags);
+	}
+
+	static GLsync traceFenceSync(GLenum condition, GLbitfield flags) {
+		TraceRecorder* t = current();
+		const GLsync sync = t->_gl.glFenceSync(condition, flags);
+		t->record(TRACE_FenceSync, condition, flags, traceHandle(sync));
+		return sync;
+	}
+
+	static GLenum traceClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+		TraceRecorder* t = current();
+		const GLenum result = t->_gl.glClientWaitSync(sync, flags, timeout);
+		t->record(TRACE_ClientWaitSync, traceHandle(sync), flags, static_cast<uint64_t>(timeout), result);
+		return result;
+	}
+
+	static void traceDeleteSync(GLsync sync) {
+		TraceRecorder* t = current();
+		t->_gl.glDeleteSync(sync);
+		t->record(TRACE_DeleteSync, traceHandle(sync));
+	}
+#endif
+
+public:
+	TraceRecorder() :
+			_ctx(nullptr), _gl(), _file(nullptr), _mask(0), _head(0), _tail(0), _cursor(0), _dropped(0), _stop(false) {
+	}
+
+	virtual ~TraceRecorder() {
+		stop();
+	}
+
+	bool isRecording() const {
+		return _ctx != nullptr;
+	}
+
+	/**
+	 * @brief Starts to record all gl calls that are issued through the given context
+	 *
+	 * @param[in] bufferSize The size of the ring buffer in bytes - rounded up to the next power of two
+	 */
+	bool start(Context* ctx, const std::string& filename, std::size_t bufferSize = 4 * 1024 * 1024) {
+		if (isRecording() || current() != nullptr) {
+			std::cerr << "there is already an active trace recorder" << std::endl;
+			return false;
+		}
+		_file = std::fopen(filename.c_str(), "wb");
+		if (_file == nullptr) {
+			std::cerr << "could not open trace file " << filename << std::endl;
+			return false;
+		}
+		std::fwrite(TRACE_MAGIC, 1, ::strlen(TRACE_MAGIC), _file);
+		const uint8_t version = TRACE_VERSION;
+		std::fwrite(&version, 1, sizeof(version), _file);
+
+		std::size_t size = 1024;
+		while (size < bufferSize) {
+			size <<= 1;
+		}
+		_ring.assign(size, 0);
+		_mask = size - 1;
+		_head = 0;
+		_tail = 0;
+		_dropped = 0;
+		_stop = false;
+		_start = std::chrono::steady_clock::now();
+
+		_ctx = ctx;
+		_gl.glCreateShader = ctx->ctx_glCreateShader;
+		_gl.glDeleteShader = ctx->ctx_glDeleteShader;
+		_gl.glShaderSource = ctx->ctx_glShaderSource;
+		_gl.glCompileShader = ctx->ctx_glCompileShader;
+		_gl.glGetShaderiv = ctx->ctx_glGetShaderiv;
+		_gl.glGetShaderInfoLog = ctx->ctx_glGetShaderInfoLog;
+		_gl.glCreateProgram = ctx->ctx_glCreateProgram;
+		_gl.glDeleteProgram = ctx->ctx_glDeleteProgram;
+		_gl.glAttachShader = ctx->ctx_glAttachShader;
+		_gl.glDetachShader = ctx->ctx_glDetachShader;
+		_gl.glLinkProgram = ctx->ctx_glLinkProgram;
+		_gl.glUseProgram = ctx->ctx_glUseProgram;
+		_gl.glGetProgramiv = ctx->ctx_glGetProgramiv;
+		_gl.glGetActiveUniform = ctx->ctx_glGetActiveUniform;
+		_gl.glGetProgramInfoLog = ctx->ctx_glGetProgramInfoLog;
+		_gl.glGetUniformLocation = ctx->ctx_glGetUniformLocation;
+		_gl.glUniform1i = ctx->ctx_glUniform1i;
+		_gl.glUniform2i = ctx->ctx_glUniform2i;
+		_gl.glUniform3i = ctx->ctx_glUniform3i;
+		_gl.glUniform4i = ctx->ctx_glUniform4i;
+		_gl.glUniform1f = ctx->ctx_glUniform1f;
+		_gl.glUniform2f = ctx->ctx_glUniform2f;
+		_gl.glUniform3f = ctx->ctx_glUniform3f;
+		_gl.glUniform4f = ctx->ctx_glUniform4f;
+		_gl.glUniform1fv = ctx->ctx_glUniform1fv;
+		_gl.glUniform2fv = ctx->ctx_glUniform2fv;
+		_gl.glUniform3fv = ctx->ctx_glUniform3fv;
+		_gl.glUniform4fv = ctx->ctx_glUniform4fv;
+		_gl.glGetActiveAttrib = ctx->ctx_glGetActiveAttrib;
+		_gl.glGetAttribLocation = ctx->ctx_glGetAttribLocation;
+		_gl.glUniformMatrix2fv = ctx->ctx_glUniformMatrix2fv;
+		_gl.glUniformMatrix3fv = ctx->ctx_glUniformMatrix3fv;
+		_gl.glUniformMatrix4fv = ctx->ctx_glUniformMatrix4fv;
+		_gl.glVertexAttrib4f = ctx->ctx_glVertexAttrib4f;
+		_gl.glVertexAttribPointer = ctx->ctx_glVertexAttribPointer;
+		_gl.glEnableVertexAttribArray = ctx->ctx_glEnableVertexAttribArray;
+		_gl.glDisableVertexAttribArray = ctx->ctx_glDisableVertexAttribArray;
+		_gl.glBindAttribLocation = ctx->ctx_glBindAttribLocation;
+		_gl.glVertexAttribDivisor = ctx->ctx_glVertexAttribDivisor;
+		_gl.glGenBuffers = ctx->ctx_glGenBuffers;
+		_gl.glDeleteBuffers = ctx->ctx_glDeleteBuffers;
+		_gl.glBindBuffer = ctx->ctx_glBindBuffer;
+		_gl.glBufferData = ctx->ctx_glBufferData;
+		_gl.glBufferSubData = ctx->ctx_glBufferSubData;
+		_gl.glDrawArraysInstanced = ctx->ctx_glDrawArraysInstanced;
+		_gl.glDrawElementsInstanced = ctx->ctx_glDrawElementsInstanced;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		_gl.glMapBufferRange = ctx->ctx_glMapBufferRange;
+		_gl.glUnmapBuffer = ctx->ctx_glUnmapBuffer;
+		_gl.glBufferStorage = ctx->ctx_glBufferStorage;
+		_gl.glFenceSync = ctx->ctx_glFenceSync;
+		_gl.glClientWaitSync = ctx->ctx_glClientWaitSync;
+		_gl.glDeleteSync = ctx->ctx_glDeleteSync;
+#endif
+
+		current() = this;
+		_writer = std::thread(&TraceRecorder::writerLoop, this);
+
+		ctx->ctx_glCreateShader = traceCreateShader;
+		ctx->ctx_glDeleteShader = traceDeleteShader;
+		ctx->ctx_glShaderSource = traceShaderSource;
+		ctx->ctx_glCompileShader = traceCompileShader;
+		ctx->ctx_glGetShaderiv = traceGetShaderiv;
+		ctx->ctx_glGetShaderInfoLog = traceGetShaderInfoLog;
+		ctx->ctx_glCreateProgram = traceCreateProgram;
+		ctx->ctx_glDeleteProgram = traceDeleteProgram;
+		ctx->ctx_glAttachShader = traceAttachShader;
+		ctx->ctx_glDetachShader = traceDetachShader;
+		ctx->ctx_glLinkProgram = traceLinkProgram;
+		ctx->ctx_glUseProgram = traceUseProgram;
+		ctx->ctx_glGetProgramiv = traceGetProgramiv;
+		ctx->ctx_glGetActiveUniform = traceGetActiveUniform;
+		ctx->ctx_glGetProgramInfoLog = traceGetProgramInfoLog;
+		ctx->ctx_glGetUniformLocation = traceGetUniformLocation;
+		ctx->ctx_glUniform1i = traceUniform1i;
+		ctx->ctx_glUniform2i = traceUniform2i;
+		ctx->ctx_glUniform3i = traceUniform3i;
+		ctx->ctx_glUniform4i = traceUniform4i;
+		ctx->ctx_glUniform1f = traceUniform1f;
+		ctx->ctx_glUniform2f = traceUniform2f;
+		ctx->ctx_glUniform3f = traceUniform3f;
+		ctx->ctx_glUniform4f = traceUniform4f;
+		ctx->ctx_glUniform1fv = traceUniform1fv;
+		ctx->ctx_glUniform2fv = traceUniform2fv;
+		ctx->ctx_glUniform3fv = traceUniform3fv;
+		ctx->ctx_glUniform4fv = traceUniform4fv;
+		ctx->ctx_glGetActiveAttrib = traceGetActiveAttrib;
+		ctx->ctx_glGetAttribLocation = traceGetAttribLocation;
+		ctx->ctx_glUniformMatrix2fv = traceUniformMatrix2fv;
+		ctx->ctx_glUniformMatrix3fv = traceUniformMatrix3fv;
+		ctx->ctx_glUniformMatrix4fv = traceUniformMatrix4fv;
+		ctx->ctx_glVertexAttrib4f = traceVertexAttrib4f;
+		// the vertex attribute, instancing and buffer mapping functions are optional - only wrap what was given
+#define TRACE_WRAP_OPTIONAL(e) if (ctx->ctx_gl##e != nullptr) ctx->ctx_gl##e = trace##e;
+		TRACE_WRAP_OPTIONAL(VertexAttribPointer)
+		TRACE_WRAP_OPTIONAL(EnableVertexAttribArray)
+		TRACE_WRAP_OPTIONAL(DisableVertexAttribArray)
+		TRACE_WRAP_OPTIONAL(BindAttribLocation)
+		TRACE_WRAP_OPTIONAL(VertexAttribDivisor)
+		TRACE_WRAP_OPTIONAL(GenBuffers)
+		TRACE_WRAP_OPTIONAL(DeleteBuffers)
+		TRACE_WRAP_OPTIONAL(BindBuffer)
+		TRACE_WRAP_OPTIONAL(BufferData)
+		TRACE_WRAP_OPTIONAL(BufferSubData)
+		TRACE_WRAP_OPTIONAL(DrawArraysInstanced)
+		TRACE_WRAP_OPTIONAL(DrawElementsInstanced)
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		TRACE_WRAP_OPTIONAL(MapBufferRange)
+		TRACE_WRAP_OPTIONAL(UnmapBuffer)
+		TRACE_WRAP_OPTIONAL(BufferStorage)
+		TRACE_WRAP_OPTIONAL(FenceSync)
+		TRACE_WRAP_OPTIONAL(ClientWaitSync)
+		TRACE_WRAP_OPTIONAL(DeleteSync)
+#endif
+#undef TRACE_WRAP_OPTIONAL
+		return true;
+	}
+
+	/**
+	 * @brief Restores the original function table of the context and flushes the remaining records
+	 */
+	void stop() {
+		if (!isRecording())
+			return;
+		endFrame();
+		_ctx->ctx_glCreateShader = _gl.glCreateShader;
+		_ctx->ctx_glDeleteShader = _gl.glDeleteShader;
+		_ctx->ctx_glShaderSource = _gl.glShaderSource;
+		_ctx->ctx_glCompileShader = _gl.glCompileShader;
+		_ctx->ctx_glGetShaderiv = _gl.glGetShaderiv;
+		_ctx->ctx_glGetShaderInfoLog = _gl.glGetShaderInfoLog;
+		_ctx->ctx_glCreateProgram = _gl.glCreateProgram;
+		_ctx->ctx_glDeleteProgram = _gl.glDeleteProgram;
+		_ctx->ctx_glAttachShader = _gl.glAttachShader;
+		_ctx->ctx_glDetachShader = _gl.glDetachShader;
+		_ctx->ctx_glLinkProgram = _gl.glLinkProgram;
+		_ctx->ctx_glUseProgram = _gl.glUseProgram;
+		_ctx->ctx_glGetProgramiv = _gl.glGetProgramiv;
+		_ctx->ctx_glGetActiveUniform = _gl.glGetActiveUniform;
+		_ctx->ctx_glGetProgramInfoLog = _gl.glGetProgramInfoLog;
+		_ctx->ctx_glGetUniformLocation = _gl.glGetUniformLocation;
+		_ctx->ctx_glUniform1i = _gl.glUniform1i;
+		_ctx->ctx_glUniform2i = _gl.glUniform2i;
+		_ctx->ctx_glUniform3i = _gl.glUniform3i;
+		_ctx->ctx_glUniform4i = _gl.glUniform4i;
+		_ctx->ctx_glUniform1f = _gl.glUniform1f;
+		_ctx->ctx_glUniform2f = _gl.glUniform2f;
+		_ctx->ctx_glUniform3f = _gl.glUniform3f;
+		_ctx->ctx_glUniform4f = _gl.glUniform4f;
+		_ctx->ctx_glUniform1fv = _gl.glUniform1fv;
+		_ctx->ctx_glUniform2fv = _gl.glUniform2fv;
+		_ctx->ctx_glUniform3fv = _gl.glUniform3fv;
+		_ctx->ctx_glUniform4fv = _gl.glUniform4fv;
+		_ctx->ctx_glGetActiveAttrib = _gl.glGetActiveAttrib;
+		_ctx->ctx_glGetAttribLocation = _gl.glGetAttribLocation;
+		_ctx->ctx_glUniformMatrix2fv = _gl.glUniformMatrix2fv;
+		_ctx->ctx_glUniformMatrix3fv = _gl.glUniformMatrix3fv;
+		_ctx->ctx_glUniformMatrix4fv = _gl.glUniformMatrix4fv;
+		_ctx->ctx_glVertexAttrib4f = _gl.glVertexAttrib4f;
+		_ctx->ctx_glVertexAttribPointer = _gl.glVertexAttribPointer;
+		_ctx->ctx_glEnableVertexAttribArray = _gl.glEnableVertexAttribArray;
+		_ctx->ctx_glDisableVertexAttribArray = _gl.glDisableVertexAttribArray;
+		_ctx->ctx_glBindAttribLocation = _gl.glBindAttribLocation;
+		_ctx->ctx_glVertexAttribDivisor = _gl.glVertexAttribDivisor;
+		_ctx->ctx_glGenBuffers = _gl.glGenBuffers;
+		_ctx->ctx_glDeleteBuffers = _gl.glDeleteBuffers;
+		_ctx->ctx_glBindBuffer = _gl.glBindBuffer;
+		_ctx->ctx_glBufferData = _gl.glBufferData;
+		_ctx->ctx_glBufferSubData = _gl.glBufferSubData;
+		_ctx->ctx_glDrawArraysInstanced = _gl.glDrawArraysInstanced;
+		_ctx->ctx_glDrawElementsInstanced = _gl.glDrawElementsInstanced;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		_ctx->ctx_glMapBufferRange = _gl.glMapBufferRange;
+		_ctx->ctx_glUnmapBuffer = _gl.glUnmapBuffer;
+		_ctx->ctx_glBufferStorage = _gl.glBufferStorage;
+		_ctx->ctx_glFenceSync = _gl.glFenceSync;
+		_ctx->ctx_glClientWaitSync = _gl.glClientWaitSync;
+		_ctx->ctx_glDeleteSync = _gl.glDeleteSync;
+#endif
+		_ctx = nullptr;
+
+		_stop = true;
+		_wakeup.notify_one();
+		_writer.join();
+		std::fclose(_file);
+		_file = nullptr;
+		current() = nullptr;
+	}
+
+	/**
+	 * @brief Marks the end of a frame and hands the recorded calls over to the writer thread
+	 */
+	void endFrame() {
+		if (!isRecording())
+			return;
+		if (_dropped > 0) {
+			const uint32_t dropped = _dropped;
+			if (record(TRACE_Dropped, dropped)) {
+				_dropped -= dropped;
+			}
+		}
+		record(TRACE_FrameEnd);
+		_wakeup.notify_one();
+	}
+};
+
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+namespace glsl {
+
+/**
+ * On-disk layout of a trace written by @c TraceRecorder
+ *
+ * The file starts with the magic @c SGTR and a version byte followed by the records. Each record is
+ * the call id (one byte), the timestamp in microseconds since the recording was started (four bytes),
+ * the varint encoded payload size and the payload. Uniform and attribute calls start their payload
+ * with the location, followed by the values - array and matrix calls store the values inline. Buffer
+ * uploads only store the target, offset and size but not the data. Sizes, offsets, pointers and sync
+ * objects are stored as 64 bit values.
+ */
+enum TraceCall {
+	TRACE_CreateShader,
+	TRACE_DeleteShader,
+	TRACE_ShaderSource,
+	TRACE_CompileShader,
+	TRACE_GetShaderiv,
+	TRACE_GetShaderInfoLog,
+	TRACE_CreateProgram,
+	TRACE_DeleteProgram,
+	TRACE_AttachShader,
+	TRACE_DetachShader,
+	TRACE_LinkProgram,
+	TRACE_UseProgram,
+	TRACE_GetProgramiv,
+	TRACE_GetActiveUniform,
+	TRACE_GetProgramInfoLog,
+	TRACE_GetUniformLocation,
+	TRACE_Uniform1i,
+	TRACE_Uniform2i,
+	TRACE_Uniform3i,
+	TRACE_Uniform4i,
+	TRACE_Uniform1f,
+	TRACE_Uniform2f,
+	TRACE_Uniform3f,
+	TRACE_Uniform4f,
+	TRACE_Uniform1fv,
+	TRACE_Uniform2fv,
+	TRACE_Uniform3fv,
+	TRACE_Uniform4fv,
+	TRACE_GetActiveAttrib,
+	TRACE_GetAttribLocation,
+	TRACE_UniformMatrix2fv,
+	TRACE_UniformMatrix3fv,
+	TRACE_UniformMatrix4fv,
+	TRACE_VertexAttrib4f,
+	TRACE_VertexAttribPointer,
+	TRACE_EnableVertexAttribArray,
+	TRACE_DisableVertexAttribArray,
+	TRACE_BindAttribLocation,
+	TRACE_VertexAttribDivisor,
+	TRACE_GenBuffers,
+	TRACE_DeleteBuffers,
+	TRACE_BindBuffer,
+	TRACE_BufferData,
+	TRACE_BufferSubData,
+	TRACE_DrawArraysInstanced,
+	TRACE_DrawElementsInstanced,
+	TRACE_MapBufferRange,
+	TRACE_UnmapBuffer,
+	TRACE_BufferStorage,
+	TRACE_FenceSync,
+	TRACE_ClientWaitSync,
+	TRACE_DeleteSync,
+	// not a gl call - marks the end of a frame
+	TRACE_FrameEnd,
+	// not a gl call - records were lost because the ring buffer was full, payload is the amount
+	TRACE_Dropped,
+
+	TRACE_MAX
+};
+
+#define TRACE_MAGIC "SGTR"
+#define TRACE_VERSION 2
+
+inline const char* translateTraceCall(int call) {
+#define TRACE_CALL_TRANSLATE(e) case TRACE_##e: return #e;
+	switch (call) {
+	TRACE_CALL_TRANSLATE(CreateShader)
+	TRACE_CALL_TRANSLATE(DeleteShader)
+	TRACE_CALL_TRANSLATE(ShaderSource)
+	TRACE_CALL_TRANSLATE(CompileShader)
+	TRACE_CALL_TRANSLATE(GetShaderiv)
+	TRACE_CALL_TRANSLATE(GetShaderInfoLog)
+	TRACE_CALL_TRANSLATE(CreateProgram)
+	TRACE_CALL_TRANSLATE(DeleteProgram)
+	TRACE_CALL_TRANSLATE(AttachShader)
+	TRACE_CALL_TRANSLATE(DetachShader)
+	TRACE_CALL_TRANSLATE(LinkProgram)
+	TRACE_CALL_TRANSLATE(UseProgram)
+	TRACE_CALL_TRANSLATE(GetProgramiv)
+	TRACE_CALL_TRANSLATE(GetActiveUniform)
+	TRACE_CALL_TRANSLATE(GetProgramInfoLog)
+	TRACE_CALL_TRANSLATE(GetUniformLocation)
+	TRACE_CALL_TRANSLATE(Uniform1i)
+	TRACE_CALL_TRANSLATE(Uniform2i)
+	TRACE_CALL_TRANSLATE(Uniform3i)
+	TRACE_CALL_TRANSLATE(Uniform4i)
+	TRACE_CALL_TRANSLATE(Uniform1f)
+	TRACE_CALL_TRANSLATE(Uniform2f)
+	TRACE_CALL_TRANSLATE(Uniform3f)
+	TRACE_CALL_TRANSLATE(Uniform4f)
+	TRACE_CALL_TRANSLATE(Uniform1fv)
+	TRACE_CALL_TRANSLATE(Uniform2fv)
+	TRACE_CALL_TRANSLATE(Uniform3fv)
+	TRACE_CALL_TRANSLATE(Uniform4fv)
+	TRACE_CALL_TRANSLATE(GetActiveAttrib)
+	TRACE_CALL_TRANSLATE(GetAttribLocation)
+	TRACE_CALL_TRANSLATE(UniformMatrix2fv)
+	TRACE_CALL_TRANSLATE(UniformMatrix3fv)
+	TRACE_CALL_TRANSLATE(UniformMatrix4fv)
+	TRACE_CALL_TRANSLATE(VertexAttrib4f)
+	TRACE_CALL_TRANSLATE(VertexAttribPointer)
+	TRACE_CALL_TRANSLATE(EnableVertexAttribArray)
+	TRACE_CALL_TRANSLATE(DisableVertexAttribArray)
+	TRACE_CALL_TRANSLATE(BindAttribLocation)
+	TRACE_CALL_TRANSLATE(VertexAttribDivisor)
+	TRACE_CALL_TRANSLATE(GenBuffers)
+	TRACE_CALL_TRANSLATE(DeleteBuffers)
+	TRACE_CALL_TRANSLATE(BindBuffer)
+	TRACE_CALL_TRANSLATE(BufferData)
+	TRACE_CALL_TRANSLATE(BufferSubData)
+	TRACE_CALL_TRANSLATE(DrawArraysInstanced)
+	TRACE_CALL_TRANSLATE(DrawElementsInstanced)
+	TRACE_CALL_TRANSLATE(MapBufferRange)
+	TRACE_CALL_TRANSLATE(UnmapBuffer)
+	TRACE_CALL_TRANSLATE(BufferStorage)
+	TRACE_CALL_TRANSLATE(FenceSync)
+	TRACE_CALL_TRANSLATE(ClientWaitSync)
+	TRACE_CALL_TRANSLATE(DeleteSync)
+	TRACE_CALL_TRANSLATE(FrameEnd)
+	TRACE_CALL_TRANSLATE(Dropped)
+	default:
+		return "UNKNOWN";
+	}
+#undef TRACE_CALL_TRANSLATE
+}
+
+inline bool isUniformTraceCall(int call) {
+	return (call >= TRACE_Uniform1i && call <= TRACE_Uniform4fv) || (call >= TRACE_UniformMatrix2fv && call <= TRACE_UniformMatrix4fv);
+}
+
+/**
+ * A single record of a trace - the payload points into the buffer given to the @c TraceReader
+ */
+struct TraceRecord {
+	int call;
+	uint32_t timestamp;
+	const uint8_t* payload;
+	uint32_t size;
+
+	template<typename T>
+	T arg(uint32_t offset) const {
+		T value = T();
+		if (offset + sizeof(T) <= size)
+			::memcpy(&value, payload + offset, sizeof(T));
+		return value;
+	}
+};
+
+/**
+ * Iterates over the records of a trace that was loaded into memory
+ */
+class TraceReader {
+protected:
+	const std::string& _buffer;
+	std::size_t _pos;
+	bool _valid;
+
+public:
+	TraceReader(const std::string& buffer) :
+			_buffer(buffer), _pos(0), _valid(false) {
+		const std::size_t magicLength = ::strlen(TRACE_MAGIC);
+		if (buffer.size() <= magicLength || buffer.compare(0, magicLength, TRACE_MAGIC) != 0)
+			return;
+		if (static_cast<uint8_t>(buffer[magicLength]) != TRACE_VERSION)
+			return;
+		_pos = magicLength + 1;
+		_valid = true;
+	}
+
+	bool isValid() const {
+		return _valid;
+	}
+
+	/**
+	 * @return @c false if there are no more records or the trace is truncated
+	 */
+	bool next(TraceRecord& record) {
+		if (!_valid || _pos + 5 > _buffer.size())
+			return false;
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(_buffer.data());
+		record.call = data[_pos];
+		::memcpy(&record.timestamp, data + _pos + 1, sizeof(record.timestamp));
+		std::size_t pos = _pos + 5;
+		uint32_t size = 0;
+		for (int shift = 0;; shift += 7) {
+			if (pos >= _buffer.size() || shift >= 35)
+				return false;
+			const uint8_t byte = data[pos++];
+			size |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		if (pos + size > _buffer.size())
+			return false;
+		record.payload = data + pos;
+		record.size = size;
+		_pos = pos + size;
+		return true;
+	}
+};
+
+}
@@ -3,11 +3,19 @@
 #include <iostream>
 #include <string>
 #include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <chrono>
 #include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
-#ifndef GLenum
+#ifndef GL_FALSE
 #error "No GL header included before including this header"
 #endif
 
@@ -24,6 +32,15 @@ namespace glsl {
 #define MAX_SHADER_VAR_NAME 128
 #endif
 
+// the glsl version that is put in front of every shader - explicit locations use layout qualifiers starting with 330/430
+#ifndef GLSL_VERSION
+#define GLSL_VERSION 120
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 class CheckErrorState {
 protected:
 	const char* _file;
@@ -71,12 +88,226 @@ public:
 #define checkError()
 #endif
 
+/**
+ * Records which programs were activated and when they were used for the first time. The
+ * serialized manifest can be merged across many sessions and replayed by @c ShaderWarmup
+ * to precompile the programs during loading screens.
+ */
+class WarmupManifest {
+public:
+	struct Entry {
+		std::string name;
+		// hash of the preprocessed sources
+		uint32_t variant;
+		// milliseconds since the recording was started
+		uint32_t firstUse;
+		// amount of sessions this entry was recorded in
+		uint32_t sessions;
+	};
+
+protected:
+	static const uint8_t VERSION = 1;
+
+	std::vector<Entry> _entries;
+	std::chrono::steady_clock::time_point _start;
+	bool _recording;
+	// the entries that were already recorded since startRecording() - name and variant
+	std::unordered_set<std::string> _recorded;
+
+	Entry* find(const std::string& name, uint32_t variant) {
+		for (Entry& e : _entries) {
+			if (e.variant == variant && e.name == name)
+				return &e;
+		}
+		return nullptr;
+	}
+
+	static void writeVarInt(std::string& out, uint32_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	static bool readVarInt(const std::string& in, std::size_t& pos, uint32_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (pos >= in.size())
+				return false;
+			const uint8_t byte = static_cast<uint8_t>(in[pos++]);
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+public:
+	WarmupManifest() :
+			_start(std::chrono::steady_clock::now()), _recording(false) {
+	}
+
+	/**
+	 * @brief Starts a new session - entries that were loaded or recorded before count as earlier sessions
+	 */
+	void startRecording() {
+		_start = std::chrono::steady_clock::now();
+		_recording = true;
+		_recorded.clear();
+	}
+
+	void stopRecording() {
+		_recording = false;
+	}
+
+	bool isRecording() const {
+		return _recording;
+	}
+
+	/**
+	 * @brief Remembers the first use of the given program variant in the current session
+	 *
+	 * If the entry is already known from an earlier session, its session counter is increased
+	 * and the earlier first use wins.
+	 *
+	 * @return @c false if the manifest is not recording
+	 */
+	bool record(const std::string& name, uint32_t variant) {
+		if (!_recording)
+			return false;
+		const std::string key = name + '\0' + std::to_string(variant);
+		if (!_recorded.insert(key).second)
+			return true;
+		const auto elapsed = std::chrono::steady_clock::now() - _start;
+		const uint32_t millis = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+		Entry* e = find(name, variant);
+		if (e == nullptr) {
+			_entries.push_back(Entry{name, variant, millis, 1});
+			return true;
+		}
+		e->firstUse = std::min(e->firstUse, millis);
+		++e->sessions;
+		return true;
+	}
+
+	/**
+	 * @brief Merges the entries of another session into this manifest
+	 *
+	 * The earliest first use wins and the session counters are summed up.
+	 */
+	void merge(const WarmupManifest& other) {
+		for (const Entry& o : other._entries) {
+			Entry* e = find(o.name, o.variant);
+			if (e == nullptr) {
+				_entries.push_back(o);
+				continue;
+			}
+			e->firstUse = std::min(e->firstUse, o.firstUse);
+			e->sessions += o.sessions;
+		}
+	}
+
+	/**
+	 * @brief Sorts the entries by priority - programs that are needed early come first,
+	 * ties are resolved in favour of the programs that were seen in more sessions.
+	 */
+	void sort() {
+		std::stable_sort(_entries.begin(), _entries.end(), [] (const Entry& a, const Entry& b) {
+			if (a.firstUse != b.firstUse)
+				return a.firstUse < b.firstUse;
+			return a.sessions > b.sessions;
+		});
+	}
+
+	const std::vector<Entry>& getEntries() const {
+		return _entries;
+	}
+
+	/**
+	 * @brief Writes the manifest into a compact binary blob (magic, version and varint encoded entries)
+	 */
+	std::string serialize() const {
+		std::string out("SGWM");
+		out.push_back(static_cast<char>(VERSION));
+		writeVarInt(out, static_cast<uint32_t>(_entries.size()));
+		for (const Entry& e : _entries) {
+			writeVarInt(out, static_cast<uint32_t>(e.name.size()));
+			out.append(e.name);
+			writeVarInt(out, e.variant);
+			writeVarInt(out, e.firstUse);
+			writeVarInt(out, e.sessions);
+		}
+		return out;
+	}
+
+	/**
+	 * @brief Merges a blob that was created by @c serialize() into this manifest
+	 *
+	 * @return @c false if the blob is invalid - nothing is merged in that case
+	 */
+	bool deserialize(const std::string& buffer) {
+		if (buffer.size() < 5 || buffer.compare(0, 4, "SGWM") != 0 || static_cast<uint8_t>(buffer[4]) != VERSION) {
+			std::cerr << "invalid warmup manifest" << std::endl;
+			return false;
+		}
+		std::size_t pos = 5;
+		uint32_t count;
+		if (!readVarInt(buffer, pos, count))
+			return false;
+		WarmupManifest session;
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t length;
+			if (!readVarInt(buffer, pos, length) || pos + length > buffer.size()) {
+				std::cerr << "truncated warmup manifest" << std::endl;
+				return false;
+			}
+			Entry e;
+			e.name = buffer.substr(pos, length);
+			pos += length;
+			if (!readVarInt(buffer, pos, e.variant) || !readVarInt(buffer, pos, e.firstUse) || !readVarInt(buffer, pos, e.sessions)) {
+				std::cerr << "truncated warmup manifest" << std::endl;
+				return false;
+			}
+			session._entries.push_back(e);
+		}
+		merge(session);
+		return true;
+	}
+};
+
 /**
  * Extend this class and hand it over to your shaders - should just be a singleton.
  */
 class Context {
 	friend class Shader;
+	friend class TraceRecorder;
+	friend class InstanceBuffer;
 public:
+	Context() :
+			_warmupManifest(nullptr), _parallelShaderCompile(false) {
+		ctx_glVertexAttribPointer = nullptr;
+		ctx_glEnableVertexAttribArray = nullptr;
+		ctx_glDisableVertexAttribArray = nullptr;
+		ctx_glBindAttribLocation = nullptr;
+		ctx_glVertexAttribDivisor = nullptr;
+		ctx_glGenBuffers = nullptr;
+		ctx_glDeleteBuffers = nullptr;
+		ctx_glBindBuffer = nullptr;
+		ctx_glBufferData = nullptr;
+		ctx_glBufferSubData = nullptr;
+		ctx_glDrawArraysInstanced = nullptr;
+		ctx_glDrawElementsInstanced = nullptr;
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+		ctx_glMapBufferRange = nullptr;
+		ctx_glUnmapBuffer = nullptr;
+		ctx_glBufferStorage = nullptr;
+		ctx_glFenceSync = nullptr;
+		ctx_glClientWaitSync = nullptr;
+		ctx_glDeleteSync = nullptr;
+#endif
+	}
+
 	virtual ~Context() {
 	}
 
@@ -155,9 +386,102 @@ public:
 		ctx_glVertexAttrib4f = _glVertexAttrib4f;
 	}
 
+	/**
+	 * @brief Call initVertexAttributes() to set the function pointers that are needed to feed vertex attributes
+	 */
+	void initVertexAttributes(
+		void (*_glVertexAttribPointer)(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* ptr),
+		void (*_glEnableVertexAttribArray)(GLuint indx),
+		void (*_glDisableVertexAttribArray)(GLuint indx)
+		) {
+		ctx_glVertexAttribPointer = _glVertexAttribPointer;
+		ctx_glEnableVertexAttribArray = _glEnableVertexAttribArray;
+		ctx_glDisableVertexAttribArray = _glDisableVertexAttribArray;
+	}
+
+	/**
+	 * @brief Optional - needed to keep the attribute locations that were assigned by the preprocessor
+	 * with @c GLSL_VERSION < 330 and to specialize programs with attributes.
+	 *
+	 * @see Shader::setExplicitLocations()
+	 */
+	void initAttributeBinding(
+		void (*_glBindAttribLocation)(GLuint program, GLuint index, const GLchar *name)
+		) {
+		ctx_glBindAttribLocation = _glBindAttribLocation;
+	}
+
+	/**
+	 * @brief Call initInstancing() to set the function pointers that are needed by @c InstanceBuffer
+	 */
+	void initInstancing(
+		void (*_glVertexAttribDivisor)(GLuint indx, GLuint divisor),
+		void (*_glGenBuffers)(GLsizei n, GLuint *buffers),
+		void (*_glDeleteBuffers)(GLsizei n, const GLuint *buffers),
+		void (*_glBindBuffer)(GLenum target, GLuint buffer),
+		void (*_glBufferData)(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage),
+		void (*_glBufferSubData)(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data),
+		void (*_glDrawArraysInstanced)(GLenum mode, GLint first, GLsizei count, GLsizei instances),
+		void (*_glDrawElementsInstanced)(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instances)
+		) {
+		ctx_glVertexAttribDivisor = _glVertexAttribDivisor;
+		ctx_glGenBuffers = _glGenBuffers;
+		ctx_glDeleteBuffers = _glDeleteBuffers;
+		ctx_glBindBuffer = _glBindBuffer;
+		ctx_glBufferData = _glBufferData;
+		ctx_glBufferSubData = _glBufferSubData;
+		ctx_glDrawArraysInstanced = _glDrawArraysInstanced;
+		ctx_glDrawElementsInstanced = _glDrawElementsInstanced;
+	}
+
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+	/**
+	 * @brief Optional - without these the @c InstanceBuffer falls back to buffer orphaning.
+	 *
+	 * @c glBufferStorage may be @c nullptr if persistent mapping is not available.
+	 */
+	void initBufferMapping(
+		void* (*_glMapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access),
+		GLboolean (*_glUnmapBuffer)(GLenum target),
+		void (*_glBufferStorage)(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags),
+		GLsync (*_glFenceSync)(GLenum condition, GLbitfield flags),
+		GLenum (*_glClientWaitSync)(GLsync sync, GLbitfield flags, GLuint64 timeout),
+		void (*_glDeleteSync)(GLsync sync)
+		) {
+		ctx_glMapBufferRange = _glMapBufferRange;
+		ctx_glUnmapBuffer = _glUnmapBuffer;
+		ctx_glBufferStorage = _glBufferStorage;
+		ctx_glFenceSync = _glFenceSync;
+		ctx_glClientWaitSync = _glClientWaitSync;
+		ctx_glDeleteSync = _glDeleteSync;
+	}
+#endif
+
 	virtual std::string loadShaderFile(const std::string& filename) const = 0;
 
+	/**
+	 * @brief Every program that is activated while the given manifest is recording is added to it.
+	 * Use @c nullptr to disable this again.
+	 *
+	 * The intended flow is to @c deserialize() the manifest of the previous sessions, call
+	 * @c WarmupManifest::startRecording(), play and @c serialize() the manifest again on shutdown.
+	 */
+	void setWarmupManifest(WarmupManifest* manifest) {
+		_warmupManifest = manifest;
+	}
+
+	/**
+	 * @brief Enable this if @c GL_KHR_parallel_shader_compile (or @c GL_ARB_parallel_shader_compile) is
+	 * available - specialized programs are then polled for completion instead of blocking on the link status.
+	 */
+	void setParallelShaderCompile(bool parallelShaderCompile) {
+		_parallelShaderCompile = parallelShaderCompile;
+	}
+
 protected:
+	WarmupManifest* _warmupManifest;
+	bool _parallelShaderCompile;
+
 	GLuint (*ctx_glCreateShader)(GLenum type);
 	void (*ctx_glDeleteShader)(GLuint id);
 	void (*ctx_glShaderSource)(GLuint id, GLuint count, const GLchar **sources, GLuint *len);
@@ -192,6 +516,26 @@ protected:
 	void (*ctx_glUniformMatrix3fv)(GLint location, int count, GLboolean transpose, GLfloat *v);
 	void (*ctx_glUniformMatrix4fv)(GLint location, int count, GLboolean transpose, GLfloat *v);
 	void (*ctx_glVertexAttrib4f)(GLuint indx, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+	void (*ctx_glVertexAttribPointer)(GLuint indx, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* ptr);
+	void (*ctx_glEnableVertexAttribArray)(GLuint indx);
+	void (*ctx_glDisableVertexAttribArray)(GLuint indx);
+	void (*ctx_glBindAttribLocation)(GLuint program, GLuint index, const GLchar *name);
+	void (*ctx_glVertexAttribDivisor)(GLuint indx, GLuint divisor);
+	void (*ctx_glGenBuffers)(GLsizei n, GLuint *buffers);
+	void (*ctx_glDeleteBuffers)(GLsizei n, const GLuint *buffers);
+	void (*ctx_glBindBuffer)(GLenum target, GLuint buffer);
+	void (*ctx_glBufferData)(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage);
+	void (*ctx_glBufferSubData)(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data);
+	void (*ctx_glDrawArraysInstanced)(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+	void (*ctx_glDrawElementsInstanced)(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instances);
+#ifdef GL_SYNC_GPU_COMMANDS_COMPLETE
+	void* (*ctx_glMapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	GLboolean (*ctx_glUnmapBuffer)(GLenum target);
+	void (*ctx_glBufferStorage)(GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
+	GLsync (*ctx_glFenceSync)(GLenum condition, GLbitfield flags);
+	GLenum (*ctx_glClientWaitSync)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+	void (*ctx_glDeleteSync)(GLsync sync);
+#endif
 };
 
 enum ShaderType {
@@ -201,17 +545,74 @@ enum ShaderType {
 };
 
 class Shader {
+	friend class InstanceBuffer;
 protected:
 	Context* _ctx;
 	GLuint _shader[SHADER_MAX];
 	GLuint _program;
 	bool _initialized;
 	mutable bool _active;
+	mutable bool _recorded;
+
+	// base filename given to loadProgram() and the hash of the preprocessed sources
+	std::string _name;
+	uint32_t _variant;
 
 	typedef std::unordered_map<std::string, int> ShaderVariables;
 	ShaderVariables _uniforms;
 	ShaderVariables _attributes;
 
+	// locations are assigned by the preprocessor - see setExplicitLocations()
+	bool _explicitLocations;
+	// set if a declaration couldn't be handled by the preprocessor
+	bool _reflect;
+	int _nextUniformLocation;
+	int _nextAttributeLocation;
+
+	// the unprocessed shader files - needed to regenerate the sources for specializations
+	std::string _buffers[SHADER_MAX];
+
+	enum UniformKind {
+		UNIFORM_INT, UNIFORM_FLOAT, UNIFORM_FLOAT_ARRAY, UNIFORM_MATRIX
+	};
+
+	// the last value that was set for a uniform location
+	struct UniformValue {
+		int kind = -1;
+		// 1-4 for vectors, 3 or 4 for matrices
+		int components = 0;
+		int count = 0;
+		bool transpose = false;
+		std::vector<uint8_t> data;
+		// update() calls without a change of the value
+		uint32_t stableFrames = 0;
+	};
+
+	// a copy of the program with some uniforms replaced by constants
+	struct Specialization {
+		GLuint shader[SHADER_MAX] = { 0, 0 };
+		GLuint program = 0;
+		// generic location -> location in the specialized program
+		std::unordered_map<int, int> remap;
+		// generic location -> the value that was compiled into the program
+		std::unordered_map<int, std::vector<uint8_t>> frozen;
+		// the tracked uniform values must be uploaded on the next activation
+		bool dirty = true;
+	};
+
+	// uniform values are only tracked if specializations are enabled
+	bool _observe;
+	uint32_t _specializationFrames;
+	mutable std::unordered_map<int, UniformValue> _values;
+	// locations that invalidated a specialization or couldn't be frozen - they are never frozen again
+	mutable std::unordered_set<int> _volatile;
+	// compiling, linked but not yet in use, in use
+	mutable std::unique_ptr<Specialization> _pending;
+	mutable std::unique_ptr<Specialization> _ready;
+	mutable std::unique_ptr<Specialization> _specialized;
+	// the generic program missed uniform updates while the specialization was in use
+	mutable bool _genericDirty;
+
 	mutable uint32_t _time;
 
 	int getAttributeLocation(const std::string& name) const {
@@ -266,10 +667,584 @@ protected:
 		}
 	}
 
+	// the amount of attribute locations a type occupies - 0 if the type is not known
+	static int getLocationSize(const std::string& type) {
+		static const char* types[] = { "float", "vec2", "vec3", "vec4", "int", "ivec2", "ivec3", "ivec4",
+				"uint", "uvec2", "uvec3", "uvec4", "bool", "bvec2", "bvec3", "bvec4", "sampler1D", "sampler2D",
+				"sampler3D", "samplerCube", "sampler1DShadow", "sampler2DShadow", "sampler2DArray", "samplerCubeShadow" };
+		if (type == "mat2")
+			return 2;
+		if (type == "mat3")
+			return 3;
+		if (type == "mat4")
+			return 4;
+		for (const char* t : types) {
+			if (type == t)
+				return 1;
+		}
+		return 0;
+	}
+
+	// splits a line of glsl code into words and the separators that matter for declarations
+	static std::vector<std::string> tokenize(const std::string& code) {
+		std::vector<std::string> tokens;
+		std::string token;
+		for (const char c : code) {
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ';' || c == '[' || c == ']') {
+				if (!token.empty())
+					tokens.push_back(token);
+				token.clear();
+				if (c == ',' || c == ';' || c == '[' || c == ']')
+					tokens.push_back(std::string(1, c));
+				continue;
+			}
+			token.push_back(c);
+		}
+		if (!token.empty())
+			tokens.push_back(token);
+		return tokens;
+	}
+
+	/**
+	 * @brief Assigns the locations of the uniforms and attributes that are declared in the given line
+	 *
+	 * Declarations are rewritten with a layout qualifier if the @c GLSL_VERSION supports it. Everything that
+	 * can't be handled here (structs, interface blocks, own layout qualifiers) makes the program fall back
+	 * to the reflection of the linked program.
+	 */
+	std::string declareLocations(ShaderType shaderType, const std::string& line) {
+		const std::size_t comment = line.find("//");
+		const std::vector<std::string>& tokens = tokenize(line.substr(0, comment));
+		if (tokens.empty())
+			return line;
+
+		const std::string& qualifier = tokens[0];
+		const bool uniform = qualifier == "uniform";
+		const bool attribute = shaderType == SHADER_VERTEX && (qualifier == "attribute" || qualifier == "in");
+		if (qualifier.compare(0, 6, "layout") == 0) {
+			_reflect = true;
+			return line;
+		}
+		if (!uniform && !attribute)
+			return line;
+
+		std::size_t i = 1;
+		std::string precision;
+		if (i < tokens.size() && (tokens[i] == "lowp" || tokens[i] == "mediump" || tokens[i] == "highp")) {
+			precision = tokens[i++] + " ";
+		}
+		if (i >= tokens.size()) {
+			_reflect = true;
+			return line;
+		}
+		const std::string& type = tokens[i++];
+		const int size = getLocationSize(type);
+		if (size == 0) {
+			_reflect = true;
+			return line;
+		}
+
+		const bool layout = uniform ? GLSL_VERSION >= 430 : GLSL_VERSION >= 330;
+		// attribute can't be combined with a layout qualifier
+		const std::string storage = uniform ? "uniform" : "in";
+		std::string out;
+		bool terminated = false;
+		while (i < tokens.size()) {
+			const std::string& name = tokens[i++];
+			int arraySize = 1;
+			std::string array;
+			if (i + 2 < tokens.size() && tokens[i] == "[" && tokens[i + 2] == "]") {
+				arraySize = ::atoi(tokens[i + 1].c_str());
+				array = "[" + tokens[i + 1] + "]";
+				i += 3;
+			}
+			if (arraySize <= 0 || i >= tokens.size() || (tokens[i] != "," && tokens[i] != ";")) {
+				_reflect = true;
+				return line;
+			}
+			terminated = tokens[i++] == ";";
+
+			int location;
+			if (uniform) {
+				// reflection reports arrays with the index of the first element
+				const std::string key = arraySize > 1 ? name + "[0]" : name;
+				ShaderVariables::const_iterator existing = _uniforms.find(key);
+				if (existing != _uniforms.end()) {
+					// declared in both stages
+					location = existing->second;
+				} else {
+					location = _nextUniformLocation;
+					_nextUniformLocation += arraySize;
+					_uniforms[key] = location;
+				}
+			} else {
+				location = _nextAttributeLocation;
+				_nextAttributeLocation += size * arraySize;
+				_attributes[name] = location;
+			}
+			out.append("layout(location = " + std::to_string(location) + ") " + storage + " " + precision + type + " " + name + array + ";\n");
+			if (terminated)
+				break;
+		}
+		// declarations that continue on the next line or are followed by more code are left to the reflection
+		if (!terminated || i != tokens.size()) {
+			_reflect = true;
+			return line;
+		}
+		if (!layout)
+			return line;
+		if (comment != std::string::npos) {
+			std::string trailing = line.substr(comment);
+			trailing.erase(trailing.find_last_not_of("\r\n") + 1);
+			out.insert(out.size() - 1, " " + trailing);
+		}
+		return out;
+	}
+
+	void assignLocations(ShaderType shaderType, std::string& src) {
+		std::string out;
+		std::size_t pos = 0;
+		while (pos < src.size()) {
+			std::size_t end = src.find('\n', pos);
+			end = end == std::string::npos ? src.size() : end + 1;
+			out.append(declareLocations(shaderType, src.substr(pos, end - pos)));
+			pos = end;
+		}
+		src = out;
+	}
+
+#ifdef _DEBUG
+	void verifyLocations(const char* kind, const ShaderVariables& assigned, const ShaderVariables& reflected) const {
+		for (const auto& r : reflected) {
+			ShaderVariables::const_iterator i = assigned.find(r.first);
+			if (i == assigned.end()) {
+				std::cerr << kind << " without an assigned location in " << _name << ": " << r.first << std::endl;
+			} else if (i->second != r.second) {
+				std::cerr << kind << " location mismatch in " << _name << ": " << r.first << " is " << r.second
+						<< " instead of " << i->second << std::endl;
+			}
+		}
+		for (const auto& a : assigned) {
+			if (reflected.find(a.first) == reflected.end()) {
+				std::cerr << kind << " with an assigned location is not active in " << _name << ": " << a.first << std::endl;
+			}
+		}
+	}
+#endif
+
+	/**
+	 * @brief Fills the location table without the enumeration of the active variables
+	 *
+	 * Uniform locations can only be assigned starting with glsl 430 - below that they are still
+	 * queried by name, but only for the declared uniforms and without @c glGetActiveUniform.
+	 */
+	void resolveLocations() {
+		if (GLSL_VERSION < 430) {
+			for (ShaderVariables::iterator i = _uniforms.begin(); i != _uniforms.end();) {
+				i->second = _ctx->ctx_glGetUniformLocation(_program, i->first.c_str());
+				// not active - reflection wouldn't report it either
+				if (i->second == -1) {
+					i = _uniforms.erase(i);
+				} else {
+					++i;
+				}
+			}
+		}
+#ifdef _DEBUG
+		// verification pass: the assigned locations must match what the linker reports - the reflection
+		// goes into temporaries, the assigned tables stay in use
+		ShaderVariables uniforms;
+		ShaderVariables attributes;
+		_uniforms.swap(uniforms);
+		_attributes.swap(attributes);
+		fetchAttributes();
+		fetchUniforms();
+		_uniforms.swap(uniforms);
+		_attributes.swap(attributes);
+		verifyLocations("uniform", _uniforms, uniforms);
+		verifyLocations("attribute", _attributes, attributes);
+#endif
+	}
+
+	// the glsl constructor for a constant of the given type - empty if the type can't be a frozen uniform
+	static std::string getConstant(const std::string& type, const UniformValue& v) {
+		if (v.count != 1 || (v.kind != UNIFORM_INT && v.kind != UNIFORM_FLOAT))
+			return "";
+		static const char* floatTypes[] = { "float", "vec2", "vec3", "vec4" };
+		static const char* intTypes[] = { "int", "ivec2", "ivec3", "ivec4" };
+		static const char* boolTypes[] = { "bool", "bvec2", "bvec3", "bvec4" };
+		const int c = v.components - 1;
+		if (v.kind == UNIFORM_FLOAT ? type != floatTypes[c] : (type != intTypes[c] && type != boolTypes[c]))
+			return "";
+		std::string constant = type + "(";
+		for (int i = 0; i < v.components; ++i) {
+			char buf[32];
+			if (v.kind == UNIFORM_FLOAT) {
+				float f;
+				::memcpy(&f, &v.data[i * sizeof(f)], sizeof(f));
+				if (!std::isfinite(f))
+					return "";
+				snprintf(buf, sizeof(buf), "%.9g", f);
+			} else {
+				int n;
+				::memcpy(&n, &v.data[i * sizeof(n)], sizeof(n));
+				snprintf(buf, sizeof(buf), "%i", n);
+			}
+			if (i > 0)
+				constant.append(", ");
+			constant.append(buf);
+		}
+		return constant + ")";
+	}
+
+	/**
+	 * @brief Replaces the declarations of the given uniforms by constants
+	 *
+	 * Only lines with complete declarations are rewritten - a name is reported as frozen only if its whole
+	 * line was replaced.
+	 *
+	 * @param[out] frozen The names of the uniforms that were replaced
+	 * @param[out] kept The names of the given uniforms that are still declared as uniforms
+	 */
+	std::string freezeUniforms(const std::string& src, const std::unordered_map<std::string, const UniformValue*>& values,
+			std::unordered_set<std::string>& frozen, std::unordered_set<std::string>& kept) const {
+		std::string out;
+		std::size_t pos = 0;
+		// inside of a uniform declaration that started on an earlier line
+		bool declaration = false;
+		while (pos < src.size()) {
+			std::size_t end = src.find('\n', pos);
+			end = end == std::string::npos ? src.size() : end + 1;
+			const std::string line = src.substr(pos, end - pos);
+			pos = end;
+
+			const std::vector<std::string>& tokens = tokenize(line.substr(0, line.find("//")));
+			const bool uniform = !tokens.empty() && tokens[0] == "uniform";
+			if (!uniform && !declaration) {
+				out.append(line);
+				continue;
+			}
+			std::string declarations;
+			std::vector<std::string> names;
+			bool valid = false;
+			if (uniform && !declaration && tokens.size() >= 4) {
+				std::size_t i = 1;
+				std::string precision;
+				if (tokens[i] == "lowp" || tokens[i] == "mediump" || tokens[i] == "highp") {
+					precision = tokens[i++] + " ";
+				}
+				const std::string& type = tokens[i++];
+				while (i + 1 < tokens.size()) {
+					const std::string& name = tokens[i++];
+					std::string array;
+					if (i + 3 < tokens.size() && tokens[i] == "[" && tokens[i + 2] == "]") {
+						array = "[" + tokens[i + 1] + "]";
+						i += 3;
+					}
+					if (tokens[i] != "," && tokens[i] != ";")
+						break;
+					const bool last = tokens[i++] == ";";
+					std::unordered_map<std::string, const UniformValue*>::const_iterator v = values.find(name);
+					const std::string constant = array.empty() && v != values.end() ? getConstant(type, *v->second) : "";
+					if (constant.empty()) {
+						declarations.append("uniform " + precision + type + " " + name + array + ";\n");
+					} else {
+						declarations.append("const " + precision + type + " " + name + " = " + constant + ";\n");
+						names.push_back(name);
+					}
+					if (last) {
+						valid = i == tokens.size();
+						break;
+					}
+				}
+			}
+			if (valid) {
+				frozen.insert(names.begin(), names.end());
+				for (const std::string& token : tokens) {
+					if (values.find(token) != values.end() && std::find(names.begin(), names.end(), token) == names.end())
+						kept.insert(token);
+				}
+				out.append(declarations);
+				continue;
+			}
+			// the line stays as it is - so do the uniforms that are declared in it
+			for (const std::string& token : tokens) {
+				if (values.find(token) != values.end())
+					kept.insert(token);
+			}
+			if (!tokens.empty()) {
+				declaration = tokens.back() != ";";
+			}
+			out.append(line);
+		}
+		return out;
+	}
+
+	void deleteSpecialization(Specialization& spec) const {
+		for (int i = 0; i < SHADER_MAX; ++i) {
+			_ctx->ctx_glDeleteShader(spec.shader[i]);
+		}
+		_ctx->ctx_glDeleteProgram(spec.program);
+	}
+
+	void resetSpecializations() {
+		std::unique_ptr<Specialization>* specs[] = { &_pending, &_ready, &_specialized };
+		for (std::unique_ptr<Specialization>* spec : specs) {
+			if (*spec) {
+				deleteSpecialization(**spec);
+				spec->reset();
+			}
+		}
+		_values.clear();
+		_volatile.clear();
+		_genericDirty = false;
+	}
+
+	// discards the given specialization if the new value differs from the frozen one
+	bool invalidates(std::unique_ptr<Specialization>& spec, int location, const void* data, std::size_t size) const {
+		if (!spec)
+			return false;
+		std::unordered_map<int, std::vector<uint8_t>>::const_iterator f = spec->frozen.find(location);
+		if (f == spec->frozen.end())
+			return false;
+		if (f->second.size() == size && ::memcmp(f->second.data(), data, size) == 0)
+			return false;
+		_volatile.insert(location);
+		deleteSpecialization(*spec);
+		spec.reset();
+		return true;
+	}
+
+	void uploadUniform(int location, const UniformValue& v) const {
+		GLfloat* f = reinterpret_cast<GLfloat*>(const_cast<uint8_t*>(v.data.data()));
+		GLint i[4];
+		GLfloat s[4];
+		::memcpy(i, v.data.data(), std::min(v.data.size(), sizeof(i)));
+		::memcpy(s, v.data.data(), std::min(v.data.size(), sizeof(s)));
+		switch (v.kind) {
+		case UNIFORM_INT:
+			switch (v.components) {
+			case 1: _ctx->ctx_glUniform1i(location, i[0]); break;
+			case 2: _ctx->ctx_glUniform2i(location, i[0], i[1]); break;
+			case 3: _ctx->ctx_glUniform3i(location, i[0], i[1], i[2]); break;
+			default: _ctx->ctx_glUniform4i(location, i[0], i[1], i[2], i[3]); break;
+			}
+			break;
+		case UNIFORM_FLOAT:
+			switch (v.components) {
+			case 1: _ctx->ctx_glUniform1f(location, s[0]); break;
+			case 2: _ctx->ctx_glUniform2f(location, s[0], s[1]); break;
+			case 3: _ctx->ctx_glUniform3f(location, s[0], s[1], s[2]); break;
+			default: _ctx->ctx_glUniform4f(location, s[0], s[1], s[2], s[3]); break;
+			}
+			break;
+		case UNIFORM_FLOAT_ARRAY:
+			switch (v.components) {
+			case 1: _ctx->ctx_glUniform1fv(location, v.count, f); break;
+			case 2: _ctx->ctx_glUniform2fv(location, v.count, f); break;
+			case 3: _ctx->ctx_glUniform3fv(location, v.count, f); break;
+			default: _ctx->ctx_glUniform4fv(location, v.count, f); break;
+			}
+			break;
+		case UNIFORM_MATRIX:
+			if (v.components == 3) {
+				_ctx->ctx_glUniformMatrix3fv(location, v.count, v.transpose ? GL_TRUE : GL_FALSE, f);
+			} else {
+				_ctx->ctx_glUniformMatrix4fv(location, v.count, v.transpose ? GL_TRUE : GL_FALSE, f);
+			}
+			break;
+		}
+	}
+
+	// restores the tracked uniform values in the currently bound program
+	void uploadUniforms(const Specialization* spec) const {
+		for (const auto& v : _values) {
+			int location = v.first;
+			if (spec != nullptr) {
+				std::unordered_map<int, int>::const_iterator r = spec->remap.find(location);
+				if (r == spec->remap.end())
+					continue;
+				location = r->second;
+			}
+			uploadUniform(location, v.second);
+		}
+		checkError();
+	}
+
+	/**
+	 * @brief Tracks the value of a uniform and maps the location to the program that is in use
+	 *
+	 * @return @c false if the gl call can be skipped
+	 */
+	bool observeUniform(int& location, int kind, int components, int count, bool transpose, const void* data) const {
+		if (location == -1)
+			return true;
+		std::size_t size = components * count * sizeof(float);
+		if (kind == UNIFORM_MATRIX)
+			size *= components;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		UniformValue& v = _values[location];
+		if (v.kind != kind || v.components != components || v.count != count || v.transpose != transpose || v.data.size() != size
+				|| ::memcmp(v.data.data(), bytes, size) != 0) {
+			v.kind = kind;
+			v.components = components;
+			v.count = count;
+			v.transpose = transpose;
+			v.data.assign(bytes, bytes + size);
+			v.stableFrames = 0;
+		}
+		invalidates(_pending, location, bytes, size);
+		invalidates(_ready, location, bytes, size);
+		if (!_specialized)
+			return true;
+		if (_specialized->frozen.find(location) != _specialized->frozen.end()) {
+			if (!invalidates(_specialized, location, bytes, size))
+				return false;
+			// fall back to the generic program - it missed all updates while the specialization was in use
+			if (!_active) {
+				_genericDirty = true;
+				return true;
+			}
+			_ctx->ctx_glUseProgram(_program);
+			// this already includes the new value
+			uploadUniforms(nullptr);
+			return false;
+		}
+		std::unordered_map<int, int>::const_iterator r = _specialized->remap.find(location);
+		if (r == _specialized->remap.end())
+			return false;
+		location = r->second;
+		return true;
+	}
+
+	/**
+	 * @brief Starts to compile a specialized program with the given uniforms replaced by their current values
+	 *
+	 * The program is not checked here - see pollSpecialization()
+	 */
+	bool startSpecialization(const std::vector<std::string>& names) {
+		if (_pending || _ready || _specialized || _program == 0)
+			return false;
+		std::unordered_map<std::string, const UniformValue*> candidates;
+		for (const std::string& name : names) {
+			ShaderVariables::const_iterator u = _uniforms.find(name);
+			if (u == _uniforms.end())
+				continue;
+			std::unordered_map<int, UniformValue>::const_iterator v = _values.find(u->second);
+			if (v != _values.end())
+				candidates[name] = &v->second;
+		}
+		std::unordered_set<std::string> frozen;
+		std::unordered_set<std::string> kept;
+		std::string src[SHADER_MAX];
+		for (;;) {
+			frozen.clear();
+			kept.clear();
+			for (int i = 0; i < SHADER_MAX; ++i) {
+				src[i] = freezeUniforms(getSource((ShaderType) i, _buffers[i]), candidates, frozen, kept);
+			}
+			if (kept.empty())
+				break;
+			// a uniform is only frozen if every stage that declares it was rewritten
+			for (const std::string& name : kept) {
+				_volatile.insert(_uniforms[name]);
+				candidates.erase(name);
+			}
+		}
+		for (const auto& c : candidates) {
+			if (frozen.find(c.first) == frozen.end())
+				_volatile.insert(_uniforms[c.first]);
+		}
+		if (frozen.empty())
+			return false;
+		if (!_attributes.empty() && _ctx->ctx_glBindAttribLocation == nullptr) {
+			std::cerr << "can't specialize " << _name << " without glBindAttribLocation" << std::endl;
+			return false;
+		}
+
+		std::unique_ptr<Specialization> spec(new Specialization());
+		for (const std::string& name : frozen) {
+			const int location = _uniforms[name];
+			spec->frozen[location] = _values[location].data;
+		}
+		spec->program = _ctx->ctx_glCreateProgram();
+		for (int i = 0; i < SHADER_MAX; ++i) {
+			spec->shader[i] = _ctx->ctx_glCreateShader(i == SHADER_VERTEX ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
+			const char *s = src[i].c_str();
+			_ctx->ctx_glShaderSource(spec->shader[i], 1, (const GLchar**) &s, nullptr);
+			_ctx->ctx_glCompileShader(spec->shader[i]);
+			_ctx->ctx_glAttachShader(spec->program, spec->shader[i]);
+		}
+		// the vertex setup of the generic program must stay valid
+		for (const auto& a : _attributes) {
+			_ctx->ctx_glBindAttribLocation(spec->program, a.second, a.first.c_str());
+		}
+		_ctx->ctx_glLinkProgram(spec->program);
+		checkError();
+		_pending = std::move(spec);
+		return true;
+	}
+
+	// checks whether the pending specialization is linked - the swap happens on the next activate()
+	void pollSpecialization() {
+		Specialization& spec = *_pending;
+		GLint status = GL_TRUE;
+		if (_ctx->_parallelShaderCompile) {
+			_ctx->ctx_glGetProgramiv(spec.program, GL_COMPLETION_STATUS_KHR, &status);
+			if (status != GL_TRUE)
+				return;
+		}
+		_ctx->ctx_glGetProgramiv(spec.program, GL_LINK_STATUS, &status);
+		checkError();
+		if (status != GL_TRUE) {
+			std::cerr << "could not link the specialized program " << _name << std::endl;
+			for (const auto& f : spec.frozen) {
+				_volatile.insert(f.first);
+			}
+			deleteSpecialization(spec);
+			_pending.reset();
+			return;
+		}
+		for (const auto& u : _uniforms) {
+			if (spec.frozen.find(u.second) != spec.frozen.end())
+				continue;
+			const int location = _ctx->ctx_glGetUniformLocation(spec.program, u.first.c_str());
+			if (location != -1)
+				spec.remap[u.second] = location;
+		}
+		_ready = std::move(_pending);
+	}
+
+	void updateSpecialization() {
+		if (!_observe)
+			return;
+		for (auto& v : _values) {
+			if (v.second.stableFrames < UINT32_MAX)
+				++v.second.stableFrames;
+		}
+		if (_pending) {
+			pollSpecialization();
+			return;
+		}
+		if (_ready || _specialized || _specializationFrames == 0)
+			return;
+		std::vector<std::string> names;
+		for (const auto& u : _uniforms) {
+			if (_volatile.find(u.second) != _volatile.end())
+				continue;
+			std::unordered_map<int, UniformValue>::const_iterator v = _values.find(u.second);
+			if (v == _values.end() || v->second.stableFrames < _specializationFrames)
+				continue;
+			names.push_back(u.first);
+		}
+		if (!names.empty())
+			startSpecialization(names);
+	}
+
 	std::string getSource(ShaderType shaderType, const std::string& buffer) const {
 		std::string src;
+		src.append("#version " + std::to_string(GLSL_VERSION) + "\n");
 #ifdef GL_ES_VERSION_2_0
-		src.append("#version 120\n");
 		if (shaderType == SHADER_FRAGMENT) {
 			src.append("#ifdef GL_ES\n");
 			src.append("precision mediump float;\n");
@@ -277,7 +1252,7 @@ protected:
 			src.append("#endif\n");
 		}
 #else
-		src.append("#version 120\n#define lowp\n#define mediump\n#define highp\n");
+		src.append("#define lowp\n#define mediump\n#define highp\n");
 #endif
 
 		std::string append(buffer);
@@ -334,6 +1309,18 @@ protected:
 		_ctx->ctx_glAttachShader(_program, frag);
 		checkError();
 
+		if (_explicitLocations && !_reflect && GLSL_VERSION < 330 && !_attributes.empty()) {
+			if (_ctx->ctx_glBindAttribLocation == nullptr) {
+				// the linker picks the attribute locations
+				_reflect = true;
+			} else {
+				for (const auto& a : _attributes) {
+					_ctx->ctx_glBindAttribLocation(_program, a.second, a.first.c_str());
+				}
+				checkError();
+			}
+		}
+
 		_ctx->ctx_glLinkProgram(_program);
 		GLint status;
 		_ctx->ctx_glGetProgramiv(_program, GL_LINK_STATUS, &status);
@@ -352,13 +1339,15 @@ protected:
 	}
 public:
 	Shader(Context* ctx) :
-			_ctx(ctx), _program(0), _initialized(false), _active(false), _time(0) {
+			_ctx(ctx), _program(0), _initialized(false), _active(false), _recorded(false), _variant(0), _explicitLocations(false), _reflect(true), _nextUniformLocation(
+					0), _nextAttributeLocation(0), _observe(false), _specializationFrames(0), _genericDirty(false), _time(0) {
 		for (int i = 0; i < SHADER_MAX; ++i) {
 			_shader[i] = 0;
 		}
 	}
 
 	virtual ~Shader() {
+		resetSpecializations();
 		for (int i = 0; i < SHADER_MAX; ++i) {
 			_ctx->ctx_glDeleteShader(_shader[i]);
 		}
@@ -380,9 +1369,9 @@ public:
 			GLint infoLogLength;
 			_ctx->ctx_glGetShaderiv(_shader[shaderType], GL_INFO_LOG_LENGTH, &infoLogLength);
 
-			std::unique_ptr < GLchar > strInfoLog(new GLchar[infoLogLength + 1]);
-			_ctx->ctx_glGetShaderInfoLog(_shader[shaderType], infoLogLength, nullptr, strInfoLog);
-			const std::string errorLog(strInfoLog, static_cast<std::size_t>(infoLogLength));
+			std::unique_ptr<GLchar[]> strInfoLog(new GLchar[infoLogLength + 1]);
+			_ctx->ctx_glGetShaderInfoLog(_shader[shaderType], infoLogLength, nullptr, strInfoLog.get());
+			const std::string errorLog(strInfoLog.get(), static_cast<std::size_t>(infoLogLength));
 
 			std::string strShaderType;
 			switch (glType) {
@@ -411,7 +1400,16 @@ public:
 			return false;
 		}
 
-		const std::string& src = getSource(shaderType, buffer);
+		_buffers[shaderType] = buffer;
+		std::string src = getSource(shaderType, buffer);
+		if (_explicitLocations) {
+			assignLocations(shaderType, src);
+		}
+		// FNV-1a over the preprocessed sources - identifies the variant in the warmup manifest
+		for (const char c : src) {
+			_variant ^= static_cast<uint8_t>(c);
+			_variant *= 16777619u;
+		}
 		return load(filename, src, shaderType);
 	}
 
@@ -424,6 +1422,15 @@ public:
 	 * @see FRAGMENT_POSTFIX
 	 */
 	bool loadProgram(const std::string& filename) {
+		_name = filename;
+		_variant = 2166136261u;
+		_recorded = false;
+		resetSpecializations();
+		_uniforms.clear();
+		_attributes.clear();
+		_reflect = !_explicitLocations;
+		_nextUniformLocation = 0;
+		_nextAttributeLocation = 0;
 		const bool vertex = loadFromFile(filename + VERTEX_POSTFIX, SHADER_VERTEX);
 		if (!vertex)
 			return false;
@@ -433,13 +1440,99 @@ public:
 			return false;
 
 		createProgramFromShaders();
-		fetchAttributes();
-		fetchUniforms();
+		if (_program != 0) {
+			if (_reflect) {
+				fetchAttributes();
+				fetchUniforms();
+			} else {
+				resolveLocations();
+			}
+		}
 		const bool success = _program != 0;
 		_initialized = success;
 		return success;
 	}
 
+	/**
+	 * @brief Let the preprocessor assign the uniform and attribute locations instead of querying them
+	 * after linking. Must be called before @c loadProgram().
+	 *
+	 * Attributes are bound via @c glBindAttribLocation (or a layout qualifier with @c GLSL_VERSION >= 330),
+	 * uniforms get a layout qualifier with @c GLSL_VERSION >= 430. Below 330 this needs
+	 * @c Context::initAttributeBinding() - without it the program falls back to the reflection of the linked
+	 * program. Build with @c _DEBUG to verify the assigned locations against that reflection.
+	 */
+	void setExplicitLocations(bool explicitLocations) {
+		_explicitLocations = explicitLocations;
+	}
+
+	/**
+	 * @brief Generates a header with the locations that were assigned by the preprocessor
+	 *
+	 * Only contains the uniforms if their locations were assigned by a layout qualifier - otherwise they
+	 * are up to the linker.
+	 */
+	std::string getLocationHeader(const std::string& namespaceName) const {
+		std::string header("// generated from " + _name + " - do not edit\n#pragma once\n\nnamespace " + namespaceName + " {\n");
+		if (_reflect) {
+			header.append("// locations were not assigned by the preprocessor\n");
+		} else {
+			std::vector<std::pair<std::string, int>> variables(_attributes.begin(), _attributes.end());
+			if (GLSL_VERSION >= 430) {
+				variables.insert(variables.end(), _uniforms.begin(), _uniforms.end());
+			}
+			std::sort(variables.begin(), variables.end());
+			for (const auto& v : variables) {
+				const std::string name = v.first.substr(0, v.first.find('['));
+				header.append("static const int " + name + " = " + std::to_string(v.second) + ";\n");
+			}
+		}
+		header.append("}\n");
+		return header;
+	}
+
+	/**
+	 * @brief Starts to track the uniform values to replace the ones that don't change by constants
+	 *
+	 * Uniforms that kept their value for the given amount of update() calls are compiled into a specialized
+	 * copy of the program - this allows the driver to unroll loops and fold branches. The copy is swapped in
+	 * on the next activate() after it was linked and dropped again as soon as one of the frozen uniforms gets
+	 * a different value. Use @c 0 to only specialize on explicit specialize() calls.
+	 *
+	 * Only non-array scalar and vector uniforms (no samplers) are frozen.
+	 *
+	 * @see Context::setParallelShaderCompile()
+	 */
+	void enableSpecialization(uint32_t frames) {
+		_observe = true;
+		_specializationFrames = frames;
+	}
+
+	/**
+	 * @brief Compiles a specialized program with the given uniforms frozen to their last set value
+	 *
+	 * @return @c false if none of the uniforms can be frozen or there is already a specialization
+	 */
+	bool specialize(const std::vector<std::string>& uniforms) {
+		if (!_observe) {
+			std::cerr << "uniform values are not tracked for " << _name << " - call enableSpecialization() first" << std::endl;
+			return false;
+		}
+		return startSpecialization(uniforms);
+	}
+
+	bool isSpecialized() const {
+		return static_cast<bool>(_specialized);
+	}
+
+	const std::string& getName() const {
+		return _name;
+	}
+
+	uint32_t getVariant() const {
+		return _variant;
+	}
+
 	/**
 	 * @brief Returns the raw shader handle
 	 */
@@ -452,6 +1545,7 @@ public:
 	 */
 	virtual void update(uint32_t deltaTime) {
 		_time += deltaTime;
+		updateSpecialization();
 	}
 
 	/**
@@ -462,8 +1556,21 @@ public:
 	 * @see
 	 */
 	virtual bool activate() const {
-		_ctx->ctx_glUseProgram(_program);
+		if (_ready) {
+			_specialized = std::move(_ready);
+		}
+		_ctx->ctx_glUseProgram(_specialized ? _specialized->program : _program);
 		checkError();
+		if (_specialized && _specialized->dirty) {
+			uploadUniforms(_specialized.get());
+			_specialized->dirty = false;
+		} else if (!_specialized && _genericDirty) {
+			uploadUniforms(nullptr);
+			_genericDirty = false;
+		}
+		if (!_recorded && _ctx->_warmupManifest != nullptr) {
+			_recorded = _ctx->_warmupManifest->record(_name, _variant);
+		}
 		_active = true;
 		return _active;
 	}
@@ -516,6 +1623,8 @@ public:
 	void setUniformf(int location, const glm::vec4& values) const;
 	void setVertexAttribute(const std::string& name, int size, int type, bool normalize, int stride, void* buffer) const;
 	void setVertexAttribute(int location, int size, int type, bool normalize, int stride, void* buffer) const;
+	void setVertexAttributeDivisor(const std::string& name, int divisor) const;
+	void setVertexAttributeDivisor(int location, int divisor) const;
 	void setAttributef(const std::string& name, float value1, float value2, float value3, float value4) const;
 	void disableVertexAttribute(const std::string& name) const;
 	void disableVertexAttribute(int location) const;
@@ -531,6 +1640,8 @@ inline void Shader::setUniformi(const std::string& name, int value) const {
 }
 
 inline void Shader::setUniformi(int location, int value) const {
+	if (_observe && !observeUniform(location, UNIFORM_INT, 1, 1, false, &value))
+		return;
 	_ctx->ctx_glUniform1i(location, value);
 	checkError();
 }
@@ -541,6 +1652,11 @@ inline void Shader::setUniformi(const std::string& name, int value1, int value2)
 }
 
 inline void Shader::setUniformi(int location, int value1, int value2) const {
+	if (_observe) {
+		const int values[] = { value1, value2 };
+		if (!observeUniform(location, UNIFORM_INT, 2, 1, false, values))
+			return;
+	}
 	_ctx->ctx_glUniform2i(location, value1, value2);
 	checkError();
 }
@@ -551,6 +1667,11 @@ inline void Shader::setUniformi(const std::string& name, int value1, int value2,
 }
 
 inline void Shader::setUniformi(int location, int value1, int value2, int value3) const {
+	if (_observe) {
+		const int values[] = { value1, value2, value3 };
+		if (!observeUniform(location, UNIFORM_INT, 3, 1, false, values))
+			return;
+	}
 	_ctx->ctx_glUniform3i(location, value1, value2, value3);
 	checkError();
 }
@@ -561,6 +1682,11 @@ inline void Shader::setUniformi(const std::string& name, int value1, int value2,
 }
 
 inline void Shader::setUniformi(int location, int value1, int value2, int value3, int value4) const {
+	if (_observe) {
+		const int values[] = { value1, value2, value3, value4 };
+		if (!observeUniform(location, UNIFORM_INT, 4, 1, false, values))
+			return;
+	}
 	_ctx->ctx_glUniform4i(location, value1, value2, value3, value4);
 	checkError();
 }
@@ -571,6 +1697,8 @@ inline void Shader::setUniformf(const std::string& name, float value) const {
 }
 
 inline void Shader::setUniformf(int location, float value) const {
+	if (_observe && !observeUniform(location, UNIFORM_FLOAT, 1, 1, false, &value))
+		return;
 	_ctx->ctx_glUniform1f(location, value);
 	checkError();
 }
@@ -581,6 +1709,11 @@ inline void Shader::setUniformf(const std::string& name, float value1, float val
 }
 
 inline void Shader::setUniformf(int location, float value1, float value2) const {
+	if (_observe) {
+		const float values[] = { value1, value2 };
+		if (!observeUniform(location, UNIFORM_FLOAT, 2, 1, false, values))
+			return;
+	}
 	_ctx->ctx_glUniform2f(location, value1, value2);
 	checkError();
 }
@@ -591,6 +1724,11 @@ inline void Shader::setUniformf(const std::string& name, float value1, float val
 }
 
 inline void Shader::setUniformf(int location, float value1, float value2, float value3) const {
+	if (_observe) {
+		const float values[] = { value1, value2, value3 };
+		if (!observeUniform(location, UNIFORM_FLOAT, 3, 1, false, values))
+			return;
+	}
 	_ctx->ctx_glUniform3f(location, value1, value2, value3);
 	checkError();
 }
@@ -601,6 +1739,11 @@ inline void Shader::setUniformf(const std::string& name, float value1, float val
 }
 
 inline void Shader::setUniformf(int location, float value1, float value2, float value3, float value4) const {
+	if (_observe) {
+		const float values[] = { value1, value2, value3, value4 };
+		if (!observeUniform(location, UNIFORM_FLOAT, 4, 1, false, values))
+			return;
+	}
 	_ctx->ctx_glUniform4f(location, value1, value2, value3, value4);
 	checkError();
 }
@@ -611,6 +1754,8 @@ inline void Shader::setUniform1fv(const std::string& name, float* values, int of
 }
 
 inline void Shader::setUniform1fv(int location, float* values, int offset, int length) const {
+	if (_observe && !observeUniform(location, UNIFORM_FLOAT_ARRAY, 1, length, false, values))
+		return;
 	_ctx->ctx_glUniform1fv(location, length, values);
 	checkError();
 }
@@ -621,6 +1766,8 @@ inline void Shader::setUniform2fv(const std::string& name, float* values, int of
 }
 
 inline void Shader::setUniform2fv(int location, float* values, int offset, int length) const {
+	if (_observe && !observeUniform(location, UNIFORM_FLOAT_ARRAY, 2, length / 2, false, values))
+		return;
 	_ctx->ctx_glUniform2fv(location, length / 2, values);
 	checkError();
 }
@@ -631,6 +1778,8 @@ inline void Shader::setUniform3fv(const std::string& name, float* values, int of
 }
 
 inline void Shader::setUniform3fv(int location, float* values, int offset, int length) const {
+	if (_observe && !observeUniform(location, UNIFORM_FLOAT_ARRAY, 3, length / 3, false, values))
+		return;
 	_ctx->ctx_glUniform3fv(location, length / 3, values);
 	checkError();
 }
@@ -641,6 +1790,8 @@ inline void Shader::setUniform4fv(const std::string& name, float* values, int of
 }
 
 inline void Shader::setUniform4fv(int location, float* values, int offset, int length) const {
+	if (_observe && !observeUniform(location, UNIFORM_FLOAT_ARRAY, 4, length / 4, false, values))
+		return;
 	_ctx->ctx_glUniform4fv(location, length / 4, values);
 	checkError();
 }
@@ -651,6 +1802,8 @@ inline void Shader::setUniformMatrix(const std::string& name, glm::mat4& matrix,
 }
 
 inline void Shader::setUniformMatrix(int location, glm::mat4& matrix, bool transpose) const {
+	if (_observe && !observeUniform(location, UNIFORM_MATRIX, 4, 1, transpose, glm::value_ptr(matrix)))
+		return;
 	_ctx->ctx_glUniformMatrix4fv(location, 1, transpose ? GL_TRUE : GL_FALSE, glm::value_ptr(matrix));
 	checkError();
 }
@@ -661,6 +1814,8 @@ inline void Shader::setUniformMatrix(const std::string& name, glm::mat3& matrix,
 }
 
 inline void Shader::setUniformMatrix(int location, glm::mat3& matrix, bool transpose) const {
+	if (_observe && !observeUniform(location, UNIFORM_MATRIX, 3, 1, transpose, glm::value_ptr(matrix)))
+		return;
 	_ctx->ctx_glUniformMatrix3fv(location, 1, transpose ? GL_TRUE : GL_FALSE, glm::value_ptr(matrix));
 	checkError();
 }
@@ -701,6 +1856,18 @@ inline void Shader::setVertexAttribute(int location, int size, int type, bool no
 	checkError();
 }
 
+inline void Shader::setVertexAttributeDivisor(const std::string& name, int divisor) const {
+	const int location = getAttributeLocation(name);
+	if (location == -1)
+		return;
+	setVertexAttributeDivisor(location, divisor);
+}
+
+inline void Shader::setVertexAttributeDivisor(int location, int divisor) const {
+	_ctx->ctx_glVertexAttribDivisor(location, divisor);
+	checkError();
+}
+
 inline void Shader::setAttributef(const std::string& name, float value1, float value2, float value3, float value4) const {
 	const int location = getAttributeLocation(name);
 	_ctx->ctx_glVertexAttrib4f(location, value1, value2, value3, value4);
@@ -739,6 +1906,78 @@ inline bool Shader::hasUniform(const std::string& name) const {
 	return _uniforms.find(name) != _uniforms.end();
 }
 
+/**
+ * Precompiles the programs of a @c WarmupManifest in priority order. Call @c update() once per
+ * frame of your loading screen with the time you are willing to spend.
+ *
+ * Override @c createShader() if your programs need your own @c Shader implementation.
+ */
+class ShaderWarmup {
+protected:
+	typedef std::unordered_map<std::string, std::unique_ptr<Shader>> Programs;
+
+	Context* _ctx;
+	std::vector<WarmupManifest::Entry> _queue;
+	std::size_t _next;
+	Programs _programs;
+
+	virtual Shader* createShader() {
+		return new Shader(_ctx);
+	}
+
+public:
+	ShaderWarmup(Context* ctx, const WarmupManifest& manifest) :
+			_ctx(ctx), _next(0) {
+		WarmupManifest sorted(manifest);
+		sorted.sort();
+		_queue = sorted.getEntries();
+	}
+
+	virtual ~ShaderWarmup() {
+	}
+
+	/**
+	 * @brief Compiles programs until the given budget is spent - at least one program is compiled per call
+	 *
+	 * @return @c true if all programs of the manifest were handled
+	 */
+	bool update(uint32_t budgetMillis) {
+		const auto start = std::chrono::steady_clock::now();
+		const auto budget = std::chrono::milliseconds(budgetMillis);
+		while (_next < _queue.size()) {
+			const WarmupManifest::Entry& e = _queue[_next++];
+			// several variants of the same program might be recorded, we can only build the current one
+			if (_programs.find(e.name) == _programs.end()) {
+				std::unique_ptr<Shader> shader(createShader());
+				if (shader->loadProgram(e.name)) {
+					_programs[e.name] = std::move(shader);
+				} else {
+					std::cerr << "could not precompile " << e.name << std::endl;
+				}
+			}
+			if (std::chrono::steady_clock::now() - start >= budget)
+				break;
+		}
+		return isDone();
+	}
+
+	bool isDone() const {
+		return _next >= _queue.size();
+	}
+
+	/**
+	 * @brief Hands out the precompiled program - returns an empty pointer if it wasn't (yet) compiled
+	 */
+	std::unique_ptr<Shader> take(const std::string& name) {
+		Programs::iterator i = _programs.find(name);
+		if (i == _programs.end())
+			return std::unique_ptr<Shader>();
+		std::unique_ptr<Shader> shader = std::move(i->second);
+		_programs.erase(i);
+		return shader;
+	}
+};
+
 class ShaderScope {
 private:
 	const Shader& _shader;
@@ -0,0 +1,154 @@
+/**
+ * Checks that uniforms which can't be replaced by constants in every stage stay uniforms of the
+ * specialized program and get their values uploaded
+ *
+ * The gl functions are replaced by a fake backend that keeps the shader sources and records the
+ * integer uniform uploads per bound program.
+ *
+ * Usage: specializationtest
+ *
+ * Link against your gl library - Shader::load() queries glGetError() directly.
+ */
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "../src/SimpleGLSL.h"
+
+#include <map>
+
+namespace {
+
+GLuint nextId = 1;
+GLuint boundProgram = 0;
+// the last program that was bound - deactivate() binds 0
+GLuint lastProgram = 0;
+std::map<GLuint, std::string> sources;
+std::map<GLuint, std::vector<GLuint>> attached;
+// program -> location -> value of every glUniform1i call
+std::map<GLuint, std::map<GLint, GLint>> intUploads;
+
+const char* uniformNames[] = { "u_mvp", "u_n", "u_k", "u_s" };
+
+const char* vertexSource =
+		"uniform int u_n;\n"
+		"uniform mat4 u_mvp;\n"
+		"void main() {}\n";
+// u_n and u_k share a line that can't be rewritten as a whole
+const char* fragmentSource =
+		"uniform int u_n; uniform float u_k;\n"
+		"uniform float u_s;\n"
+		"void main() {}\n";
+
+class FakeContext: public glsl::Context {
+public:
+	FakeContext() {
+		init(
+			[] (GLenum) -> GLuint {return nextId++;},
+			[] (GLuint) {},
+			[] (GLuint id, GLuint, const GLchar **s, GLuint *) {sources[id] = s[0];},
+			[] (GLuint) {},
+			[] (GLuint, GLenum, GLint *dest) {*dest = GL_TRUE;},
+			[] (GLuint, GLuint, GLuint *, GLchar *) {},
+			[] () -> GLuint {return nextId++;},
+			[] (GLuint) {},
+			[] (GLuint program, GLuint shader) {attached[program].push_back(shader);},
+			[] (GLuint, GLuint) {},
+			[] (GLuint) {},
+			[] (GLuint program) {
+				boundProgram = program;
+				if (program != 0)
+					lastProgram = program;
+			},
+			[] (GLuint, GLenum field, GLint *dest) {
+				*dest = field == GL_ACTIVE_UNIFORMS ? 4 : field == GL_ACTIVE_ATTRIBUTES ? 0 : GL_TRUE;
+			},
+			[] (GLuint, GLuint index, GLsizei bufSize, GLsizei *, GLint *, GLenum *, GLchar *name) {
+				::strncpy(name, uniformNames[index], bufSize);
+			},
+			[] (GLuint, GLuint, GLuint *, GLchar *) {},
+			[] (GLuint, const GLchar *name) -> GLint {
+				for (int i = 0; i < 4; ++i) {
+					if (::strcmp(name, uniformNames[i]) == 0)
+						return i;
+				}
+				return -1;
+			},
+			[] (GLint location, GLint i) {intUploads[boundProgram][location] = i;},
+			[] (GLint, GLint, GLint) {},
+			[] (GLint, GLint, GLint, GLint) {},
+			[] (GLint, GLint, GLint, GLint, GLint) {},
+			[] (GLint, GLfloat) {},
+			[] (GLint, GLfloat, GLfloat) {},
+			[] (GLint, GLfloat, GLfloat, GLfloat) {},
+			[] (GLint, GLfloat, GLfloat, GLfloat, GLfloat) {},
+			[] (GLint, int, GLfloat *) {},
+			[] (GLint, int, GLfloat *) {},
+			[] (GLint, int, GLfloat *) {},
+			[] (GLint, int, GLfloat *) {},
+			[] (GLuint, GLuint, GLsizei, GLsizei *, GLint *, GLenum *, GLchar *) {},
+			[] (GLuint, const GLchar *) -> GLint {return -1;},
+			[] (GLint, int, GLboolean, GLfloat *) {},
+			[] (GLint, int, GLboolean, GLfloat *) {},
+			[] (GLint, int, GLboolean, GLfloat *) {},
+			[] (GLuint, GLfloat, GLfloat, GLfloat, GLfloat) {});
+	}
+
+	std::string loadShaderFile(const std::string& filename) const override {
+		return filename.find("_vs") != std::string::npos ? vertexSource : fragmentSource;
+	}
+};
+
+int failures = 0;
+
+void check(bool condition, const std::string& message) {
+	if (!condition) {
+		std::cerr << "FAILED: " << message << std::endl;
+		++failures;
+	}
+}
+
+}
+
+int main() {
+	FakeContext ctx;
+	glsl::Shader shader(&ctx);
+	if (!shader.loadProgram("test")) {
+		std::cerr << "could not load the fake program" << std::endl;
+		return 1;
+	}
+	shader.enableSpecialization(2);
+
+	glm::mat4 mvp(1.0f);
+	for (int frame = 0; frame < 6 && !shader.isSpecialized(); ++frame) {
+		shader.activate();
+		shader.setUniformi("u_n", 3);
+		shader.setUniformf("u_k", 0.25f);
+		shader.setUniformf("u_s", 0.5f);
+		shader.setUniformMatrix("u_mvp", mvp);
+		shader.deactivate();
+		shader.update(16);
+	}
+	// the swap happens on activate() - u_n keeps its value, so the set itself might be skipped
+	shader.activate();
+	shader.setUniformi("u_n", 3);
+	shader.deactivate();
+
+	check(shader.isSpecialized(), "the program was not specialized");
+	const GLuint program = lastProgram;
+	const std::vector<GLuint>& shaders = attached[program];
+	check(shaders.size() == 2, "the specialized program has no vertex and fragment shader");
+	if (shaders.size() == 2) {
+		const std::string& vertex = sources[shaders[0]];
+		const std::string& fragment = sources[shaders[1]];
+		check(fragment.find("uniform int u_n; uniform float u_k;") != std::string::npos, "the multi-declaration line was changed");
+		check(fragment.find("const float u_s = float(0.5);") != std::string::npos, "u_s was not frozen");
+		check(vertex.find("uniform int u_n;") != std::string::npos, "u_n was frozen in the vertex stage only");
+	}
+	const std::map<GLint, GLint>& uploads = intUploads[program];
+	std::map<GLint, GLint>::const_iterator n = uploads.find(1);
+	check(n != uploads.end() && n->second == 3, "u_n was not uploaded to the specialized program");
+
+	if (failures == 0)
+		std::cout << "all checks passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/**
+ * Compares the object throughput of the per-object uniform path with the glsl::InstanceBuffer path
+ *
+ * The gl functions are replaced by a fake backend that only copies the data it is given, so the
+ * numbers show the cpu overhead on our side and the amount of calls that reach the driver.
+ *
+ * Usage: instancingbench [objects] [frames]
+ *
+ * Link against your gl library - Shader::load() queries glGetError() directly.
+ */
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "../src/InstanceBuffer.h"
+
+#include <cstdlib>
+#include <chrono>
+
+namespace {
+
+uint64_t calls = 0;
+// the fake driver state - every call copies its arguments in here
+float state[64];
+std::vector<uint8_t> storage;
+
+const char* uniformNames[] = { "u_model", "u_color" };
+const char* attributeNames[] = { "a_pos", "a_model", "a_color" };
+// a_model is a mat4 and occupies four locations
+const GLint attributeLocations[] = { 0, 1, 5 };
+
+class FakeContext: public glsl::Context {
+public:
+	FakeContext(bool mapping) {
+		init(
+			[] (GLenum) -> GLuint {return 1;},
+			[] (GLuint) {},
+			[] (GLuint, GLuint, const GLchar **, GLuint *) {},
+			[] (GLuint) {},
+			[] (GLuint, GLenum, GLint *dest) {*dest = GL_TRUE;},
+			[] (GLuint, GLuint, GLuint *, GLchar *) {},
+			[] () -> GLuint {return 1;},
+			[] (GLuint) {},
+			[] (GLuint, GLuint) {},
+			[] (GLuint, GLuint) {},
+			[] (GLuint) {},
+			[] (GLuint) {++calls;},
+			[] (GLuint, GLenum field, GLint *dest) {
+				*dest = field == GL_ACTIVE_UNIFORMS ? 2 : field == GL_ACTIVE_ATTRIBUTES ? 3 : GL_TRUE;
+			},
+			[] (GLuint, GLuint index, GLsizei bufSize, GLsizei *, GLint *, GLenum *, GLchar *name) {
+				::strncpy(name, uniformNames[index], bufSize);
+			},
+			[] (GLuint, GLuint, GLuint *, GLchar *) {},
+			[] (GLuint, const GLchar *name) -> GLint {return ::strcmp(name, uniformNames[0]) == 0 ? 0 : 1;},
+			[] (GLint, GLint) {++calls;},
+			[] (GLint, GLint, GLint) {++calls;},
+			[] (GLint, GLint, GLint, GLint) {++calls;},
+			[] (GLint, GLint, GLint, GLint, GLint) {++calls;},
+			[] (GLint, GLfloat f) {state[0] = f; ++calls;},
+			[] (GLint, GLfloat f1, GLfloat f2) {state[0] = f1; state[1] = f2; ++calls;},
+			[] (GLint, GLfloat f1, GLfloat f2, GLfloat f3) {state[0] = f1; state[1] = f2; state[2] = f3; ++calls;},
+			[] (GLint, GLfloat f1, GLfloat f2, GLfloat f3, GLfloat f4) {state[0] = f1; state[1] = f2; state[2] = f3; state[3] = f4; ++calls;},
+			[] (GLint, int count, GLfloat *f) {::memcpy(state, f, count * sizeof(float)); ++calls;},
+			[] (GLint, int count, GLfloat *f) {::memcpy(state, f, count * 2 * sizeof(float)); ++calls;},
+			[] (GLint, int count, GLfloat *f) {::memcpy(state, f, count * 3 * sizeof(float)); ++calls;},
+			[] (GLint, int count, GLfloat *f) {::memcpy(state, f, count * 4 * sizeof(float)); ++calls;},
+			[] (GLuint, GLuint index, GLsizei bufSize, GLsizei *, GLint *, GLenum *, GLchar *name) {
+				::strncpy(name, attributeNames[index], bufSize);
+			},
+			[] (GLuint, const GLchar *name) -> GLint {
+				for (int i = 0; i < 3; ++i) {
+					if (::strcmp(name, attributeNames[i]) == 0)
+						return attributeLocations[i];
+				}
+				return -1;
+			},
+			[] (GLint, int count, GLboolean, GLfloat *v) {::memcpy(state, v, count * 4 * sizeof(float)); ++calls;},
+			[] (GLint, int count, GLboolean, GLfloat *v) {::memcpy(state, v, count * 9 * sizeof(float)); ++calls;},
+			[] (GLint, int count, GLboolean, GLfloat *v) {::memcpy(state, v, count * 16 * sizeof(float)); ++calls;},
+			[] (GLuint, GLfloat, GLfloat, GLfloat, GLfloat) {++calls;});
+		initVertexAttributes(
+			[] (GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid*) {++calls;},
+			[] (GLuint) {++calls;},
+			[] (GLuint) {++calls;});
+		initInstancing(
+			[] (GLuint, GLuint) {++calls;},
+			[] (GLsizei, GLuint *buffers) {*buffers = 1;},
+			[] (GLsizei, const GLuint *) {},
+			[] (GLenum, GLuint) {++calls;},
+			[] (GLenum, GLsizeiptr size, const GLvoid *, GLenum) {storage.resize(size); ++calls;},
+			[] (GLenum, GLintptr offset, GLsizeiptr size, const GLvoid *data) {::memcpy(&storage[offset], data, size); ++calls;},
+			[] (GLenum, GLint, GLsizei, GLsizei) {++calls;},
+			[] (GLenum, GLsizei, GLenum, const GLvoid *, GLsizei) {++calls;});
+		if (mapping) {
+			initBufferMapping(
+				[] (GLenum, GLintptr offset, GLsizeiptr, GLbitfield) -> void* {++calls; return &storage[offset];},
+				[] (GLenum) -> GLboolean {++calls; return GL_TRUE;},
+				[] (GLenum, GLsizeiptr size, const GLvoid *, GLbitfield) {storage.resize(size); ++calls;},
+				[] (GLenum, GLbitfield) -> GLsync {++calls; return reinterpret_cast<GLsync>(&storage[0]);},
+				[] (GLsync, GLbitfield, GLuint64) -> GLenum {++calls; return GL_ALREADY_SIGNALED;},
+				[] (GLsync) {++calls;});
+		}
+	}
+
+	std::string loadShaderFile(const std::string&) const override {
+		return "void main() {}";
+	}
+};
+
+struct Object {
+	glm::mat4 model;
+	glm::vec4 color;
+};
+
+// one frame with a uniform update and a draw call per object
+void drawPerObject(const glsl::Shader& shader, std::vector<Object>& objects) {
+	shader.activate();
+	for (Object& o : objects) {
+		shader.setUniformMatrix("u_model", o.model);
+		shader.setUniformf("u_color", o.color);
+		// stands in for glDrawArrays
+		++calls;
+	}
+	shader.deactivate();
+}
+
+// one frame that streams the objects into the instance buffer
+void drawInstanced(const glsl::Shader& shader, glsl::InstanceBuffer& instances, std::vector<Object>& objects) {
+	shader.activate();
+	for (Object& o : objects) {
+		float* data = instances.add();
+		if (data == nullptr) {
+			instances.drawArrays(shader, GL_TRIANGLES, 0, 36);
+			data = instances.add();
+		}
+		::memcpy(data, glm::value_ptr(o.model), 16 * sizeof(float));
+		::memcpy(data + 16, glm::value_ptr(o.color), 4 * sizeof(float));
+	}
+	instances.drawArrays(shader, GL_TRIANGLES, 0, 36);
+	shader.deactivate();
+}
+
+template<typename Func>
+void measure(const char* name, std::size_t objects, int frames, Func func) {
+	calls = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; ++i) {
+		func();
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	const double seconds = std::chrono::duration<double>(elapsed).count();
+	std::cout << name << ": " << static_cast<uint64_t>(objects * frames / seconds) << " objects/s, "
+			<< calls / frames << " gl calls per frame" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	const std::size_t numObjects = argc > 1 ? std::atoi(argv[1]) : 10000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+
+	std::vector<Object> objects(numObjects);
+	for (std::size_t i = 0; i < numObjects; ++i) {
+		objects[i].model = glm::mat4(static_cast<float>(i));
+		objects[i].color = glm::vec4(1.0f, 0.5f, 0.25f, 1.0f);
+	}
+
+	for (int mapping = 0; mapping < 2; ++mapping) {
+		FakeContext ctx(mapping != 0);
+		glsl::Shader shader(&ctx);
+		if (!shader.loadProgram("bench")) {
+			std::cerr << "could not load the fake program" << std::endl;
+			return 1;
+		}
+		glsl::InstanceBuffer instances(&ctx, 4096);
+		instances.addAttribute(shader, "a_model", 4, 4);
+		instances.addAttribute(shader, "a_color", 4);
+		if (!instances.init())
+			return 1;
+
+		std::cout << (mapping ? "with buffer mapping" : "with buffer orphaning") << std::endl;
+		measure("  uniforms ", numObjects, frames, [&] () {drawPerObject(shader, objects);});
+		measure("  instanced", numObjects, frames, [&] () {drawInstanced(shader, instances, objects);});
+	}
+	return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * Offline analyzer for traces written by glsl::TraceRecorder
+ *
+ * Replays the recorded calls against a fake backend that only tracks the bound program and the
+ * uniform values and reports per frame:
+ * - redundant program binds
+ * - redundant uniform sets (same value for the same location of the bound program)
+ * - uniform lookup misses (uniform calls with location -1 and failed location queries)
+ * - the amount of calls that were issued while a program was bound, including its bind
+ *
+ * If records were dropped while recording, the tracked state is reset and the redundancy numbers
+ * of that frame are marked as unreliable.
+ *
+ * Usage: traceanalyzer <tracefile>
+ */
+
+#include "../src/ShaderTraceFormat.h"
+
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+
+namespace {
+
+struct FrameStats {
+	uint32_t calls = 0;
+	uint32_t programBinds = 0;
+	uint32_t redundantProgramBinds = 0;
+	uint32_t uniformSets = 0;
+	uint32_t redundantUniformSets = 0;
+	uint32_t uniformLookupMisses = 0;
+	uint32_t dropped = 0;
+	uint32_t duration = 0;
+	std::map<uint32_t, uint32_t> programCalls;
+};
+
+/**
+ * Mimics the state of the gl context that matters for the analysis
+ */
+class FakeBackend {
+private:
+	typedef std::map<int32_t, std::string> UniformValues;
+
+	uint32_t _program = 0;
+	std::map<uint32_t, UniformValues> _uniforms;
+
+public:
+	void replay(const glsl::TraceRecord& r, FrameStats& stats) {
+		if (r.call != glsl::TRACE_Dropped) {
+			++stats.calls;
+		}
+		switch (r.call) {
+		case glsl::TRACE_UseProgram: {
+			const uint32_t program = r.arg<uint32_t>(0);
+			++stats.programBinds;
+			if (program == _program && program != 0) {
+				++stats.redundantProgramBinds;
+			}
+			_program = program;
+			break;
+		}
+		case glsl::TRACE_LinkProgram:
+		case glsl::TRACE_DeleteProgram:
+			// linking resets the uniform values, deleted ids might be reused
+			_uniforms.erase(r.arg<uint32_t>(0));
+			break;
+		case glsl::TRACE_GetUniformLocation:
+			if (r.arg<int32_t>(sizeof(uint32_t)) == -1) {
+				++stats.uniformLookupMisses;
+			}
+			break;
+		case glsl::TRACE_Dropped:
+			// the lost calls might have bound programs or set uniforms - nothing we tracked is reliable anymore
+			stats.dropped += r.arg<uint32_t>(0);
+			_program = 0;
+			_uniforms.clear();
+			break;
+		default:
+			if (!glsl::isUniformTraceCall(r.call))
+				break;
+			++stats.uniformSets;
+			const int32_t location = r.arg<int32_t>(0);
+			if (location == -1) {
+				++stats.uniformLookupMisses;
+				break;
+			}
+			// the call id is part of the value - a vec2 and a vec3 set with the same bytes are not redundant
+			std::string value(1, static_cast<char>(r.call));
+			value.append(reinterpret_cast<const char*>(r.payload) + sizeof(int32_t), r.size - sizeof(int32_t));
+			UniformValues& values = _uniforms[_program];
+			UniformValues::iterator i = values.find(location);
+			if (i != values.end() && i->second == value) {
+				++stats.redundantUniformSets;
+				break;
+			}
+			values[location] = value;
+			break;
+		}
+		// counted after the call was applied - a bind belongs to the program that gets bound
+		if (_program != 0 && r.call != glsl::TRACE_Dropped) {
+			++stats.programCalls[_program];
+		}
+	}
+};
+
+void printStats(const std::string& label, const FrameStats& stats) {
+	std::cout << label << ": " << stats.calls << " calls, " << stats.duration << "us" << std::endl;
+	const char* unreliable = stats.dropped > 0 ? ", unreliable" : "";
+	std::cout << "  program binds: " << stats.programBinds << " (redundant: " << stats.redundantProgramBinds << unreliable << ")" << std::endl;
+	std::cout << "  uniform sets: " << stats.uniformSets << " (redundant: " << stats.redundantUniformSets << unreliable << ")" << std::endl;
+	std::cout << "  uniform lookup misses: " << stats.uniformLookupMisses << std::endl;
+	if (stats.dropped > 0) {
+		std::cout << "  dropped records: " << stats.dropped << std::endl;
+	}
+	for (const auto& p : stats.programCalls) {
+		std::cout << "  program " << p.first << ": " << p.second << " calls" << std::endl;
+	}
+}
+
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 2) {
+		std::cerr << "usage: " << argv[0] << " <tracefile>" << std::endl;
+		return 1;
+	}
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file) {
+		std::cerr << "could not open " << argv[1] << std::endl;
+		return 1;
+	}
+	std::stringstream ss;
+	ss << file.rdbuf();
+	const std::string buffer = ss.str();
+
+	glsl::TraceReader reader(buffer);
+	if (!reader.isValid()) {
+		std::cerr << "invalid trace file " << argv[1] << std::endl;
+		return 1;
+	}
+
+	FakeBackend backend;
+	FrameStats stats;
+	FrameStats total;
+	std::size_t frame = 0;
+	uint32_t frameStart = 0;
+	bool first = true;
+	glsl::TraceRecord r;
+	while (reader.next(r)) {
+		if (first) {
+			frameStart = r.timestamp;
+			first = false;
+		}
+		if (r.call == glsl::TRACE_FrameEnd) {
+			stats.duration = r.timestamp - frameStart;
+			frameStart = r.timestamp;
+			printStats("frame " + std::to_string(frame++), stats);
+			total.calls += stats.calls;
+			total.programBinds += stats.programBinds;
+			total.redundantProgramBinds += stats.redundantProgramBinds;
+			total.uniformSets += stats.uniformSets;
+			total.redundantUniformSets += stats.redundantUniformSets;
+			total.uniformLookupMisses += stats.uniformLookupMisses;
+			total.dropped += stats.dropped;
+			total.duration += stats.duration;
+			for (const auto& p : stats.programCalls) {
+				total.programCalls[p.first] += p.second;
+			}
+			stats = FrameStats();
+			continue;
+		}
+		backend.replay(r, stats);
+	}
+	printStats("total over " + std::to_string(frame) + " frames", total);
+	return 0;
+}